@@ -1,4 +1,5 @@
 #include "robustDcf.h"
+#include <Timezone.h>
 
 RobustDcf rd(PB6,true);
 
@@ -34,7 +35,7 @@ void runClock()
  */
 void serialParseLoggingTest()
 {
-    SecondsDecoder::BITDATA bd;
+    SecondsDecoder::BITDATA bd = {};
     bd.validBitCtr = 60;
     Chronos::EpochTime epoch;
     while (Serial1.available() > 0)
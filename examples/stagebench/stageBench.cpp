@@ -0,0 +1,276 @@
+/*
+ * This file is part of RobustDcf.
+ * 
+ * RobustDcf is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Foobar is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Foobar.  If not, see <https://www.gnu.org/licenses/>.
+ * 
+ * Copyright Christoph Tack, 2018
+*/
+#include "stageBench.h"
+#include <math.h>
+#ifdef ARDUINO
+#if defined(DWT) && defined(CoreDebug)
+#define STAGEBENCH_CYCLE_COUNTER
+#endif
+#else
+#include <chrono>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define STAGEBENCH_CYCLE_COUNTER
+#endif
+#endif
+
+static uint32_t secondTicks = 0;
+
+static void countSecond(void *, const bool, const SECONDS_DATA, const SOFT_PULSE)
+{
+    secondTicks++;
+}
+
+/**
+ * @brief CPU cycles since some moment in the past.  On x86 hosts, this is the time stamp counter, which only counts core cycles when
+ * the CPU runs at its nominal clock.
+ */
+static uint64_t cycleCount()
+{
+#if defined(STAGEBENCH_CYCLE_COUNTER) && defined(ARDUINO)
+    return DWT->CYCCNT;
+#elif defined(STAGEBENCH_CYCLE_COUNTER)
+    return __rdtsc();
+#else
+    return 0;
+#endif
+}
+
+static uint64_t nanoseconds()
+{
+#ifdef ARDUINO
+    return micros() * 1000ULL;
+#else
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+/**
+ * @brief Create the benchmarks.  The phase detectors are detached from the SysTick, so that only the benchmarks feed them.
+ * @param inputPin pin that is read by the sampling benchmark.  Its level doesn't matter.
+ * @param ops number of calls of each stage.  The DWT cycle counter wraps around after 2^32 cycles, so keep the product of ops and the
+ * cycles per call below that on the target.
+ */
+StageBench::StageBench(const byte inputPin, const uint32_t ops) : _ops(ops), _pd(inputPin, true), _rd(inputPin, true)
+{
+    //An hour of minute frames : 2018-11-24, 03:00 up to 03:59 CET
+    FrameDecoder::FRAME frame = {0, 3, 24, 6, 11, 18, false, true, false};
+    for (uint8_t i = 0; i < MINUTES; i++)
+    {
+        frame.minute = i;
+        _frames[i] = FrameDecoder::encode(frame);
+    }
+    _pd.detach();
+    _rd._pd.detach();
+}
+
+bool StageBench::hasCycleCounter()
+{
+#ifdef STAGEBENCH_CYCLE_COUNTER
+    return true;
+#else
+    return false;
+#endif
+}
+
+/**
+ * @brief Measure all stages.  The results are reported in the order that the stages are listed in runStages().
+ * @param report called with the result of each stage, once all of them have been measured
+ * @param repeats all stages are measured this many times, the fastest run of each stage is reported.  That filters out interruptions
+ * by the OS and changes of the clock speed.
+ */
+void StageBench::run(resultEvent report, const uint8_t repeats)
+{
+#if defined(STAGEBENCH_CYCLE_COUNTER) && defined(ARDUINO)
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+#endif
+    for (uint8_t i = 0; i < STAGE_COUNT; i++)
+    {
+        _results[i] = {nullptr, _ops, INFINITY, hasCycleCounter() ? INFINITY : NAN};
+    }
+    for (uint8_t repeat = 0; repeat < (repeats ? repeats : 1); repeat++)
+    {
+        _stage = 0;
+        runStages();
+    }
+    for (uint8_t i = 0; i < _stage; i++)
+    {
+        report(_results[i]);
+    }
+}
+
+void StageBench::runStages()
+{
+    const uint8_t binCount = ROBUSTDCF_BIN_COUNT;
+
+    //Bins that don't saturate : each sweep adds 1 to all bins, the next one takes it off again
+    _bins.clear();
+    uint8_t index = 0;
+    int8_t step = 1;
+    measure("bin_add", [&]() {
+        _sink += _bins.add(index, step);
+        if (++index == binCount)
+        {
+            index = 0;
+            step = -step;
+        }
+    });
+
+    //All bins at the maximum : each add moves the offset
+    _saturated.clear();
+    index = 0;
+    measure("bin_add_saturated", [&]() {
+        _sink += _saturated.add(index, 1);
+        index = index + 1 < binCount ? index + 1 : 0;
+    });
+
+    for (uint8_t i = 0; i < binCount; i++)
+    {
+        _bins.set(i, (i * 37) % 101 - 50);
+    }
+    measure("bin_maximum", [&]() { _sink += _bins.maximum(0); });
+
+    //The SysTick ISR : a pin sample, averaged and queued as a bin each 10ms.  The queue is emptied before it's full.
+    lockPhaseDetector();
+    measure("sample_isr", [&]() {
+        _pd.process_one_sample();
+        if (_pd._pendingBins.size() > PhaseDetector::PENDING_BINS / 2)
+        {
+            _pd._pendingBins.clear();
+        }
+    });
+    measure("averager", [&]() {
+        _pd.averager();
+        if (_pd._pendingBins.size() > PhaseDetector::PENDING_BINS / 2)
+        {
+            _pd._pendingBins.clear();
+        }
+    });
+
+    //The deferred stage, on a locked phase detector
+    lockPhaseDetector();
+    measure("phase_binning", [&]() { _pd.phase_binning(binVote(_pd._activeBin + 1)); });
+    lockPhaseDetector();
+    measure("phase_correlator", [&]() {
+        _pd._activeBin = _pd.wrap(_pd._activeBin + 1);
+        _pd.slideWindow();
+        _sink += _pd.phaseCorrelator();
+    });
+    lockPhaseDetector();
+    measure("seconds_sampler", [&]() {
+        _pd._activeBin = _pd.wrap(_pd._activeBin + 1);
+        _pd.secondsSampler(binVote(_pd._activeBin) > 0 ? HIGHV : LOWV);
+    });
+    lockPhaseDetector();
+    uint16_t bin = 0;
+    measure("process_bin", [&]() {
+        _pd.queueVote(binVote(bin));
+        _sink += _pd.process_one_bin();
+        bin = bin + 1 < binCount ? bin + 1 : 0;
+    });
+
+    //Each second of an hour, as the phase detector reports them
+    SecondsDecoder sd;
+    uint8_t second = 0, minute = 0;
+    measure("update_seconds", [&]() {
+        const bool syncMark = second == SecondsDecoder::SECONDS_PER_MINUTE - 1;
+        const bool longPulse = !syncMark && ((_frames[minute] >> second) & 1);
+        const SOFT_PULSE soft = {(int8_t)(syncMark ? SOFT_SCALE : -SOFT_SCALE), (int8_t)(longPulse ? SOFT_SCALE : -SOFT_SCALE)};
+        sd.updateSeconds(longPulse ? LONGPULSE : SHORTPULSE, soft);
+        if (++second == SecondsDecoder::SECONDS_PER_MINUTE)
+        {
+            second = 0;
+            minute = minute + 1 < MINUTES ? minute + 1 : 0;
+        }
+    });
+
+    //Complete minutes
+    BcdDecoder minutes(21, 7, true, 0, 59);
+    minute = 0;
+    measure("bcd_update", [&]() {
+        SecondsDecoder::BITDATA data = {_frames[minute], SecondsDecoder::SECONDS_PER_MINUTE - 1, 0};
+        _sink += minutes.update(&data);
+        minute = minute + 1 < MINUTES ? minute + 1 : 0;
+    });
+    _rd.init();
+    minute = 0;
+    measure("update_clock", [&]() {
+        SecondsDecoder::BITDATA data = {_frames[minute], SecondsDecoder::SECONDS_PER_MINUTE - 1, 0};
+        Chronos::EpochTime epoch;
+        _sink += _rd.updateClock(&data, &epoch);
+        minute = minute + 1 < MINUTES ? minute + 1 : 0;
+    });
+}
+
+/**
+ * @brief Call an operation _ops times and keep the result when it's the fastest run of the stage so far.
+ */
+template <class Operation>
+void StageBench::measure(const char *stage, Operation operation)
+{
+#if defined(STAGEBENCH_CYCLE_COUNTER) && defined(ARDUINO)
+    //The SysTick is blocked, so micros() doesn't count : the time follows from the cycles
+    noInterrupts();
+    const uint32_t startCycles = cycleCount();
+    for (uint32_t i = 0; i < _ops; i++)
+    {
+        operation();
+    }
+    const uint32_t cycles = cycleCount() - startCycles;
+    interrupts();
+    const float nsPerOp = cycles * (1e9f / F_CPU) / _ops;
+#else
+    const uint64_t startTime = nanoseconds(), startCycles = cycleCount();
+    for (uint32_t i = 0; i < _ops; i++)
+    {
+        operation();
+    }
+    const uint64_t cycles = cycleCount() - startCycles;
+    const float nsPerOp = (float)(nanoseconds() - startTime) / _ops;
+#endif
+    RESULT &result = _results[_stage++];
+    result.stage = stage;
+    result.nsPerOp = nsPerOp < result.nsPerOp ? nsPerOp : result.nsPerOp;
+    if (hasCycleCounter() && (float)cycles / _ops < result.cyclesPerOp)
+    {
+        result.cyclesPerOp = (float)cycles / _ops;
+    }
+}
+
+/**
+ * @brief Restart the phase detector and feed it clean seconds, until the phase is locked.
+ */
+void StageBench::lockPhaseDetector()
+{
+    _pd.init(countSecond);
+    for (uint16_t i = 0; i < LOCK_SECONDS * ROBUSTDCF_BIN_COUNT; i++)
+    {
+        _pd.queueVote(binVote(i % ROBUSTDCF_BIN_COUNT));
+        _pd.process_one_bin();
+    }
+}
+
+/**
+ * @brief The vote of a bin in a clean second : a short pulse at the start of the second.
+ */
+int8_t StageBench::binVote(uint16_t bin)
+{
+    return bin % ROBUSTDCF_BIN_COUNT < ROBUSTDCF_BIN_COUNT / 10 ? HIGHV : LOWV;
+}
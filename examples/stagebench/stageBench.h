@@ -0,0 +1,61 @@
+/*
+ * This file is part of RobustDcf.
+ * 
+ * RobustDcf is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Foobar is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Foobar.  If not, see <https://www.gnu.org/licenses/>.
+ * 
+ * Copyright Christoph Tack, 2018
+*/
+/* Microbenchmarks of the decoder stages, to keep an eye on the time budget of the SysTick ISR and of the deferred stage.
+ * Each stage is called many times with realistic input and the time per call is reported, together with the number of CPU cycles
+ * when there's a cycle counter : the DWT cycle counter on Cortex-M3 and up, the time stamp counter on x86 hosts.
+ * On the target, the stages run with interrupts disabled, so that the SysTick doesn't add to the measurements.
+ */
+#pragma once
+#include "robustDcf.h"
+#include "bcdDecoder.h"
+
+class StageBench
+{
+public:
+	typedef struct
+	{
+		const char *stage;	//!<name of the function that has been measured
+		uint32_t ops;		//!<number of calls
+		float nsPerOp;		//!<time per call
+		float cyclesPerOp;	//!<CPU cycles per call, NAN when there's no cycle counter
+	} RESULT;
+	typedef void (*resultEvent)(const RESULT &result);
+	StageBench(const byte inputPin, const uint32_t ops);
+	void run(resultEvent report, const uint8_t repeats = 1);
+	static bool hasCycleCounter();
+
+private:
+	static const uint8_t STAGE_COUNT = 12;
+	static const uint8_t MINUTES = 60;		//!<the minutes that are decoded, one hour
+	static const uint8_t LOCK_SECONDS = 5;	//!<clean seconds that are fed to the phase detector before measuring it
+	void runStages();
+	template <class Operation>
+	void measure(const char *stage, Operation operation);
+	void lockPhaseDetector();
+	int8_t binVote(uint16_t bin);
+	uint32_t _ops;
+	RESULT _results[STAGE_COUNT];
+	uint8_t _stage = 0;
+	Bin<ROBUSTDCF_BIN_COUNT> _bins;
+	Bin<ROBUSTDCF_BIN_COUNT, INT8_MAX> _saturated;
+	PhaseDetector _pd;
+	RobustDcf _rd;
+	uint64_t _frames[MINUTES];
+	volatile uint32_t _sink = 0; //!<results of the calls, so that the compiler can't leave them out
+};
@@ -0,0 +1,33 @@
+/* Measures the time and the CPU cycles that each stage of the decoder takes on the target.
+ * The results are printed as comma separated values, in the same format as test-framework/dcfStageBench, so that they can be
+ * compared with a baseline : "dcfStageBench --baseline" on the host, or any spreadsheet.
+ */
+#include "stageBench.h"
+
+StageBench bench(PB6, 2000);
+
+void printResult(const StageBench::RESULT &result)
+{
+    Serial1.print(result.stage);
+    Serial1.print(',');
+    Serial1.print(result.ops);
+    Serial1.print(',');
+    Serial1.print(result.nsPerOp, 2);
+    Serial1.print(',');
+    if (!isnan(result.cyclesPerOp))
+    {
+        Serial1.print(result.cyclesPerOp, 1);
+    }
+    Serial1.println();
+}
+
+void setup()
+{
+    Serial1.begin(115200);
+    Serial1.println("stage,ops,ns_per_op,cycles_per_op");
+    bench.run(printResult, 3);
+}
+
+void loop()
+{
+}
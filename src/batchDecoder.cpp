@@ -0,0 +1,153 @@
+/*
+ * This file is part of RobustDcf.
+ * 
+ * RobustDcf is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Foobar is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Foobar.  If not, see <https://www.gnu.org/licenses/>.
+ * 
+ * Copyright Christoph Tack, 2018
+*/
+#ifndef ARDUINO
+#include "batchDecoder.h"
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+/**
+ * @brief Decode a sequence of minute frames.  Consecutive calls continue the same sequence.
+ * @param frames the bits of each minute, bit 0 is the first second of the minute
+ * @param n number of frames
+ * @param out receives the result for each frame
+ * @returns the number of valid frames
+ */
+size_t BatchDecoder::decodeFrames(const uint64_t *frames, size_t n, DECODED_MINUTE *out)
+{
+    uint64_t packedFields[CHUNK_SIZE];
+    size_t validCount = 0;
+    for (size_t start = 0; start < n; start += CHUNK_SIZE)
+    {
+        const size_t count = min(n - start, CHUNK_SIZE);
+        checkFrames(frames + start, count, packedFields);
+        for (size_t i = 0; i < count; i++)
+        {
+            //Same order as in RobustDcf::updateClock() : the time zone votes are updated for all frames
+            SecondsDecoder::BITDATA data = {frames[start + i], SecondsDecoder::SECONDS_PER_MINUTE, 0};
+            const bool timeZoneValid = _tzd.update(&data);
+            DECODED_MINUTE *pResult = out + start + i;
+            const uint64_t fields = packedFields[i];
+            pResult->valid = timeZoneValid && (fields & VALID_FLAG);
+            if (!pResult->valid)
+            {
+                continue;
+            }
+            FrameDecoder::FRAME &frame = pResult->frame;
+            for (uint8_t j = 0; j < FrameDecoder::FIELD_COUNT; j++)
+            {
+                frame.*FrameDecoder::FIELDS[j].value = fields >> (8 * j);
+            }
+            frame.isSummerTime = data.bitShifter & FrameDecoder::CEST_BIT;
+            frame.isWinterTime = data.bitShifter & FrameDecoder::CET_BIT;
+            frame.timeZoneChangeAnnounced = data.bitShifter & FrameDecoder::TIMEZONE_CHANGE_BIT;
+            pResult->unixEpoch = _epoch.update(frame, _tzd.getSecondsOffset(&data));
+            validCount++;
+        }
+    }
+    return validCount;
+}
+
+/**
+ * @brief Forget the time zone history and the previous minute
+ */
+void BatchDecoder::clear()
+{
+    _tzd.clear();
+    _epoch.clear();
+}
+
+/**
+ * @brief Stage 1 for a single frame
+ * @returns the fields in the order of FrameDecoder::FIELDS, one per byte, and VALID_FLAG when the frame is valid
+ */
+uint64_t BatchDecoder::checkFrame(const uint64_t frame)
+{
+    const SecondsDecoder::BITDATA data = {frame, SecondsDecoder::SECONDS_PER_MINUTE, 0};
+    FrameDecoder::FRAME decoded;
+    uint64_t fields = FrameDecoder::decode(&data, decoded) ? VALID_FLAG : 0;
+    for (uint8_t j = 0; j < FrameDecoder::FIELD_COUNT; j++)
+    {
+        fields |= (uint64_t)(decoded.*FrameDecoder::FIELDS[j].value) << (8 * j);
+    }
+    return fields;
+}
+
+#ifdef __AVX2__
+//Parity of each 64bit lane, in bit 0
+static inline __m256i parity(__m256i x)
+{
+    x = _mm256_xor_si256(x, _mm256_srli_epi64(x, 32));
+    x = _mm256_xor_si256(x, _mm256_srli_epi64(x, 16));
+    x = _mm256_xor_si256(x, _mm256_srli_epi64(x, 8));
+    x = _mm256_xor_si256(x, _mm256_srli_epi64(x, 4));
+    x = _mm256_xor_si256(x, _mm256_srli_epi64(x, 2));
+    x = _mm256_xor_si256(x, _mm256_srli_epi64(x, 1));
+    return _mm256_and_si256(x, _mm256_set1_epi64x(1));
+}
+
+//Extract a BCD field from each lane, convert it to binary and check its range.  Invalid lanes get set in the error mask.
+static inline __m256i bcdField(const __m256i frames, const int startBit, const int bitWidth, const int lowest, const int highest, __m256i &errors)
+{
+    const __m256i bcd = _mm256_and_si256(_mm256_srli_epi64(frames, startBit), _mm256_set1_epi64x((1 << bitWidth) - 1));
+    const __m256i tens = _mm256_srli_epi64(bcd, 4);
+    const __m256i value = _mm256_add_epi64(_mm256_and_si256(bcd, _mm256_set1_epi64x(0xF)),
+                                           _mm256_add_epi64(_mm256_slli_epi64(tens, 3), _mm256_slli_epi64(tens, 1)));
+    errors = _mm256_or_si256(errors, _mm256_cmpgt_epi64(_mm256_set1_epi64x(lowest), value));
+    errors = _mm256_or_si256(errors, _mm256_cmpgt_epi64(value, _mm256_set1_epi64x(highest)));
+    return value;
+}
+#endif
+
+/**
+ * @brief Stage 1 : check and extract the fields of all frames.  The result is the same as that of checkFrame() for each frame.
+ * The parity groups and fields are taken from the tables of FrameDecoder.
+ */
+void BatchDecoder::checkFrames(const uint64_t *frames, size_t n, uint64_t *packedFields)
+{
+    size_t i = 0;
+#ifdef __AVX2__
+    for (; i + 4 <= n; i += 4)
+    {
+        const __m256i bits = _mm256_loadu_si256((const __m256i *)(frames + i));
+        __m256i errors = _mm256_setzero_si256();
+        for (uint8_t j = 0; j < FrameDecoder::PARITY_GROUP_COUNT; j++)
+        {
+            const FrameDecoder::PARITY_GROUP &group = FrameDecoder::PARITY_GROUPS[j];
+            const __m256i groupBits = _mm256_and_si256(_mm256_srli_epi64(bits, group.startBit), _mm256_set1_epi64x((1ULL << group.bitWidth) - 1));
+            errors = _mm256_or_si256(errors, parity(groupBits));
+        }
+        errors = _mm256_cmpeq_epi64(errors, _mm256_set1_epi64x(1));
+        __m256i fields = _mm256_setzero_si256();
+        for (uint8_t j = 0; j < FrameDecoder::FIELD_COUNT; j++)
+        {
+            const FrameDecoder::FIELD &field = FrameDecoder::FIELDS[j];
+            const __m256i value = bcdField(bits, field.startBit, field.bitWidth, field.lowestValue, field.highestValue, errors);
+            fields = _mm256_or_si256(fields, _mm256_slli_epi64(value, 8 * j));
+        }
+        fields = _mm256_or_si256(fields, _mm256_andnot_si256(errors, _mm256_set1_epi64x(VALID_FLAG)));
+        _mm256_storeu_si256((__m256i *)(packedFields + i), fields);
+    }
+#endif
+    for (; i < n; i++)
+    {
+        packedFields[i] = checkFrame(frames[i]);
+    }
+}
+#endif
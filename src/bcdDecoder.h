@@ -19,7 +19,7 @@
 /*  The BcdDecoder gets some BCD-encoded data bytes of the SecondsDecoder, checks validity and converts these to decimal values.
  */
 #pragma once
-#include "Arduino.h"
+#include "platform.h"
 #include "bin.h"
 #include "secondsDecoder.h"
 class BcdDecoder
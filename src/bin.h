@@ -17,23 +17,250 @@
  * Copyright Christoph Tack, 2018
 */
 #pragma once
-#include "Arduino.h"
+#include "platform.h"
 static const uint8_t INVALID = 0xFF;
 
+//smallest power of two that is not smaller than n
+constexpr uint16_t nextPowerOfTwo(uint16_t n, uint16_t p = 1)
+{
+    return p >= n ? p : nextPowerOfTwo(n, p << 1);
+}
+
+/**
+ * @brief Data is stored in different bins.  Each bin holds some data value.
+ * Saturation of a bin is handled by shifting a common offset, so that the cost of each operation doesn't depend on the number of bins (apart from a rare rebase).
+ * The two highest bins are kept in a tournament tree, which is updated each time a bin changes.
+ * The storage is part of the object, so the RAM use is known at link time.  The constructor runs at compile time for static objects.
+ * The values are stored in 16bit, with the offset added to them, so that the tree compares the stored values directly.  Once the
+ * offset reaches REBASE_OFFSET, it's taken off all bins again.  Bins that are not updated while the offset moves (e.g. the bins
+ * outside the low power window) are limited to FLOOR then.
+ * RAM : 2 * N + 2 * LEAF_COUNT + 2 bytes, LEAF_COUNT being N rounded up to a power of two.
+ * @tparam N the number of different bins
+ * @tparam INIT the initial value for all bins
+ */
+template <uint8_t N, int8_t INIT = 0>
 class Bin
 {
+    static_assert(N > 0 && N < INVALID, "N out of range");
+
 public:
-    Bin(uint8_t dataSize, int8_t initVal = 0);
-    ~Bin();
-    void add(uint8_t index, int8_t N);
-    void clear();
+    constexpr Bin();
+    bool add(uint8_t index, int8_t value);
+    constexpr void clear();
     uint8_t maximum(int8_t threshold);
-    uint8_t count();
+    int16_t margin();
+    static constexpr uint8_t count() { return N; }
+    constexpr int32_t get(uint8_t index) const;
+    void set(uint8_t index, int8_t value);
     uint8_t getUnsigned(uint8_t index);
-   
+
 private:
-    void bounded_increment(uint8_t index, int8_t N);
-    int8_t *_pData = nullptr;
-    uint8_t _dataSize = 0;
-    int8_t _initVal = 0;
+    static constexpr uint16_t LEAF_COUNT = nextPowerOfTwo(N);
+    typedef struct
+    {
+        uint8_t leader;
+        uint8_t runnerUp;
+    } RANKING;
+    constexpr int8_t value(uint8_t index) const;
+    constexpr bool isHigher(uint8_t index, uint8_t other) const;
+    constexpr RANKING rankingOf(uint16_t node) const;
+    void updateRanking(uint8_t index);
+    void rebase();
+    static constexpr int16_t FLOOR = -16384;        //lowest value of a bin after rebase(), far below the 8bit range
+    static constexpr int16_t REBASE_OFFSET = 8192;  //offset at which rebase() is called
+    int16_t _data[N] = {};                 //bin values, stored with _offset added to them
+    RANKING _ranking[LEAF_COUNT] = {};     //tournament tree holding the two highest bins below each node
+    int16_t _offset = 0;                   //0 to REBASE_OFFSET, so that the stored values stay within 16bit
 };
+
+template <uint8_t N, int8_t INIT>
+constexpr Bin<N, INIT>::Bin()
+{
+    clear();
+}
+
+/**
+ * @brief Add a value to the bin[index]
+ * If the bin is already at its maximum, the other bins are decreased by the value instead.  This is done by moving the offset of all bins.
+ * A negative value lowers a saturated bin like any other bin.  Otherwise, a long period without signal would raise all bins
+ * above the maximum, and the bins would no longer follow the signal when it's back.
+ * @returns true when bin[index] was saturated, so that the other bins have been changed instead.
+ */
+template <uint8_t N, int8_t INIT>
+bool Bin<N, INIT>::add(uint8_t index, int8_t value)
+{
+    const int8_t current = this->value(index);
+    bool saturated = current == INT8_MAX && value > 0;
+    if (saturated)
+    {
+        _offset += value;
+        _data[index] = _offset + INT8_MAX;
+        if (_offset >= REBASE_OFFSET)
+        {
+            rebase();
+        }
+    }
+    else
+    {
+        const int16_t result = current + value;
+        _data[index] = _offset + (result > INT8_MAX ? INT8_MAX : result < INT8_MIN ? INT8_MIN : result);
+    }
+    updateRanking(index);
+    return saturated;
+}
+
+template <uint8_t N, int8_t INIT>
+constexpr void Bin<N, INIT>::clear()
+{
+    _offset = 0;
+    for (uint8_t i = 0; i < N; i++)
+    {
+        _data[i] = INIT;
+    }
+    for (uint16_t node = LEAF_COUNT - 1; node > 0; --node)
+    {
+        _ranking[node] = rankingOf(node);
+    }
+}
+
+/**
+ * @brief Get the value of a bin, without limiting it to 8bit.
+ * Bins that have been pushed down by a saturated bin may be below INT8_MIN until they get updated again, down to
+ * FLOOR - REBASE_OFFSET - INT8_MAX.
+ */
+template <uint8_t N, int8_t INIT>
+constexpr int32_t Bin<N, INIT>::get(uint8_t index) const
+{
+    return _data[index] - _offset;
+}
+
+/**
+ * @brief Overwrite the value of a bin, e.g. to restore a saved state.
+ */
+template <uint8_t N, int8_t INIT>
+void Bin<N, INIT>::set(uint8_t index, int8_t value)
+{
+    _data[index] = _offset + value;
+    updateRanking(index);
+}
+
+/**
+ * @brief Bins contain 8bit signed values, the function will offset the value in the bin to make it unsigned
+ */
+template <uint8_t N, int8_t INIT>
+uint8_t Bin<N, INIT>::getUnsigned(uint8_t index)
+{
+    return value(index) + 128;
+}
+
+/**
+ * @brief Find the bin that contains the highest value and return its index.
+ * Only a single peak maximum is desired.  So there should be a significant difference to the second largest number.
+ */
+template <uint8_t N, int8_t INIT>
+uint8_t Bin<N, INIT>::maximum(int8_t threshold)
+{
+    const int8_t THRESHOLD = 2; //Minimum difference required between largest and second largest number.
+    const RANKING ranking = LEAF_COUNT > 1 ? _ranking[1] : rankingOf(1);
+    if (ranking.leader == INVALID)
+    {
+        return INVALID;
+    }
+    const int16_t maximum = value(ranking.leader);
+    const int16_t max2nd = ranking.runnerUp == INVALID ? INT8_MIN : value(ranking.runnerUp);
+    return maximum >= threshold && maximum - max2nd >= THRESHOLD ? ranking.leader : INVALID;
+}
+
+/**
+ * @brief Difference between the highest and the second highest bin, as used by maximum().  0 when there are less than two bins.
+ */
+template <uint8_t N, int8_t INIT>
+int16_t Bin<N, INIT>::margin()
+{
+    const RANKING ranking = LEAF_COUNT > 1 ? _ranking[1] : rankingOf(1);
+    if (ranking.leader == INVALID || ranking.runnerUp == INVALID)
+    {
+        return 0;
+    }
+    return value(ranking.leader) - value(ranking.runnerUp);
+}
+
+/**
+ * @brief Value of the bin, limited to the 8bit range
+ */
+template <uint8_t N, int8_t INIT>
+constexpr int8_t Bin<N, INIT>::value(uint8_t index) const
+{
+    const int32_t val = get(index);
+    return val > INT8_MAX ? INT8_MAX : val < INT8_MIN ? INT8_MIN : val;
+}
+
+/**
+ * @brief true when bin[index] holds a higher value than bin[other].  INVALID bins are lower than any other bin.
+ */
+template <uint8_t N, int8_t INIT>
+constexpr bool Bin<N, INIT>::isHigher(uint8_t index, uint8_t other) const
+{
+    if (index == INVALID)
+    {
+        return false;
+    }
+    return other == INVALID || _data[index] > _data[other];
+}
+
+/**
+ * @brief Get the two highest bins below a node of the tree.  Node 1 is the root, the children of node n are 2n and 2n+1.
+ * Nodes from LEAF_COUNT onwards are the leaves, i.e. the bins themselves.  On equal values, the lowest bin ranks first.
+ */
+template <uint8_t N, int8_t INIT>
+constexpr typename Bin<N, INIT>::RANKING Bin<N, INIT>::rankingOf(uint16_t node) const
+{
+    if (node >= LEAF_COUNT)
+    {
+        const uint8_t index = node - LEAF_COUNT;
+        return {index < N ? index : INVALID, INVALID};
+    }
+    const RANKING left = (node << 1) >= LEAF_COUNT ? rankingOf(node << 1) : _ranking[node << 1];
+    const RANKING right = (node << 1) + 1 >= LEAF_COUNT ? rankingOf((node << 1) + 1) : _ranking[(node << 1) + 1];
+    if (isHigher(right.leader, left.leader))
+    {
+        return {right.leader, isHigher(right.runnerUp, left.leader) ? right.runnerUp : left.leader};
+    }
+    return {left.leader, isHigher(right.leader, left.runnerUp) ? right.leader : left.runnerUp};
+}
+
+/**
+ * @brief The value of a bin has changed.  Replay the matches on the path from that bin to the root of the tree.
+ * Moving the offset doesn't change the order of the other bins, so that doesn't require an update.
+ */
+template <uint8_t N, int8_t INIT>
+void Bin<N, INIT>::updateRanking(uint8_t index)
+{
+    for (uint16_t node = (LEAF_COUNT + index) >> 1; node > 0; node >>= 1)
+    {
+        _ranking[node] = rankingOf(node);
+    }
+}
+
+/**
+ * @brief Take the offset off all bins, and limit the bins that have been pushed down the most to FLOOR.
+ * The offset has to move by REBASE_OFFSET first, so the cost per add() stays small.  Only bins that haven't been updated for a long
+ * time get limited, the others keep their value.
+ */
+template <uint8_t N, int8_t INIT>
+void Bin<N, INIT>::rebase()
+{
+    bool limited = false;
+    for (uint8_t i = 0; i < N; i++)
+    {
+        const int16_t value = _data[i] - _offset;
+        limited = limited || value < FLOOR;
+        _data[i] = value < FLOOR ? FLOOR : value;
+    }
+    _offset = 0;
+    //Taking off the offset doesn't change the order of the bins, limiting them may
+    for (uint16_t node = LEAF_COUNT - 1; limited && node > 0; --node)
+    {
+        _ranking[node] = rankingOf(node);
+    }
+}
@@ -0,0 +1,74 @@
+/*
+ * This file is part of RobustDcf.
+ * 
+ * RobustDcf is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Foobar is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Foobar.  If not, see <https://www.gnu.org/licenses/>.
+ * 
+ * Copyright Christoph Tack, 2018
+*/
+#include "epochCalculator.h"
+
+constexpr uint16_t EpochCalculator::DAYS_BEFORE_MONTH[];
+
+/**
+ * @brief UTC time stamp of a decoded minute.  When it follows the previous minute within the same hour and time zone,
+ * the previous time stamp is reused.
+ * @param utcOffset seconds that the local time is ahead of UTC
+ */
+Chronos::EpochTime EpochCalculator::update(const FrameDecoder::FRAME &frame, int16_t utcOffset)
+{
+    if (_lastValid && frame.minute == _lastFrame.minute + 1 && frame.hour == _lastFrame.hour && frame.day == _lastFrame.day &&
+        frame.month == _lastFrame.month && frame.year == _lastFrame.year && utcOffset == _lastOffset)
+    {
+        _lastEpoch += 60;
+    }
+    else
+    {
+        _lastEpoch = toEpoch(frame, utcOffset);
+    }
+    _lastFrame = frame;
+    _lastOffset = utcOffset;
+    _lastValid = true;
+    return _lastEpoch;
+}
+
+/**
+ * @brief The opposite of daysSinceEpoch() : the date for a number of days since 1970-01-01, in 2000-2099.
+ * @param year 0-99, year in the century
+ */
+void EpochCalculator::civilFromDays(int32_t days, uint8_t &year, uint8_t &month, uint8_t &day)
+{
+    //Each block of four years starts with a leap year
+    days -= DAYS_UNTIL_2000;
+    year = days / 1461 * 4;
+    days %= 1461;
+    if (days >= 366)
+    {
+        days -= 366;
+        year += 1 + days / 365;
+        days %= 365;
+    }
+    const bool leapYear = isLeapYear(year);
+    for (month = 12; days < DAYS_BEFORE_MONTH[month] + (month > 2 && leapYear); month--)
+    {
+    }
+    day = days - DAYS_BEFORE_MONTH[month] - (month > 2 && leapYear) + 1;
+}
+
+/**
+ * @brief Forget the previous minute, so that the next one is calculated from its fields.
+ */
+void EpochCalculator::clear()
+{
+    _lastValid = false;
+}
@@ -0,0 +1,70 @@
+/*
+ * This file is part of RobustDcf.
+ * 
+ * RobustDcf is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Foobar is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Foobar.  If not, see <https://www.gnu.org/licenses/>.
+ * 
+ * Copyright Christoph Tack, 2018
+*/
+/* The EpochCalculator converts decoded DCF77 minutes to UTC time stamps without any library calls.
+ * DCF77 only transmits the year in the century, so only 2000-2099 must be handled.  In that range, every fourth year is a
+ * leap year, which turns the date calculation into a few table lookups.  Consecutive minutes of the same hour only add 60s
+ * to the previous result.
+ */
+#pragma once
+#include "platform.h"
+#include "frameDecoder.h"
+#ifdef ARDUINO
+#include <Chronos.h>
+#endif
+
+class EpochCalculator
+{
+public:
+	static const int32_t SECONDS_PER_DAY = 86400;
+	static const int32_t DAYS_UNTIL_2000 = 10957; //!<days between 1970-01-01 and 2000-01-01
+	static constexpr uint16_t DAYS_BEFORE_MONTH[13] = {0, 0, 31, 59, 90, 120, 151, 181, 212, 243, 273, 304, 334}; //!<index 1-12, in a common year
+	/**
+	 * @brief In 2000-2099, every fourth year is a leap year.
+	 * @param year 0-99, year in the century
+	 */
+	static constexpr bool isLeapYear(uint8_t year)
+	{
+		return !(year & 3);
+	}
+	/**
+	 * @brief Number of days between 1970-01-01 and the given date.
+	 * @param year 0-99, year in the century
+	 */
+	static constexpr int32_t daysSinceEpoch(uint8_t year, uint8_t month, uint8_t day)
+	{
+		return DAYS_UNTIL_2000 + 365L * year + (year + 3) / 4 + DAYS_BEFORE_MONTH[month] + (month > 2 && isLeapYear(year)) + day - 1;
+	}
+	/**
+	 * @brief UTC time stamp of a local DCF77 time.
+	 * @param utcOffset seconds that the local time is ahead of UTC
+	 */
+	static constexpr Chronos::EpochTime toEpoch(const FrameDecoder::FRAME &frame, int16_t utcOffset)
+	{
+		return daysSinceEpoch(frame.year, frame.month, frame.day) * SECONDS_PER_DAY + frame.hour * 3600L + frame.minute * 60L - utcOffset;
+	}
+	static void civilFromDays(int32_t days, uint8_t &year, uint8_t &month, uint8_t &day);
+	Chronos::EpochTime update(const FrameDecoder::FRAME &frame, int16_t utcOffset);
+	void clear();
+
+private:
+	FrameDecoder::FRAME _lastFrame;
+	int16_t _lastOffset = 0;
+	Chronos::EpochTime _lastEpoch = 0;
+	bool _lastValid = false;
+};
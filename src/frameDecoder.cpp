@@ -0,0 +1,161 @@
+/*
+ * This file is part of RobustDcf.
+ * 
+ * RobustDcf is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Foobar is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Foobar.  If not, see <https://www.gnu.org/licenses/>.
+ * 
+ * Copyright Christoph Tack, 2018
+*/
+#include "frameDecoder.h"
+
+constexpr FrameDecoder::FIELD FrameDecoder::FIELDS[];
+constexpr FrameDecoder::PARITY_GROUP FrameDecoder::PARITY_GROUPS[];
+
+/**
+ * @brief Check and decode a complete minute frame.
+ * @param data the bits of the previous minute
+ * @param frame receives the decoded fields.  Only to be used when the function returns true.
+ * @returns true when the frame is complete, all parity checks pass and all fields are within range.
+ */
+bool FrameDecoder::decode(const SecondsDecoder::BITDATA *data, FRAME &frame)
+{
+	return !decodeErrors(data, frame);
+}
+
+/**
+ * @brief Same as decode(), but tells which checks failed.
+ * All checks are evaluated, their results are combined with bitwise operators instead of returning early.
+ * @returns 0 when the frame is valid.  Otherwise bit i is set for each parity group i that fails, bit RANGE_ERROR_SHIFT + i for
+ * each field i that is out of range and INCOMPLETE_ERROR when bits are missing.
+ */
+uint16_t FrameDecoder::decodeErrors(const SecondsDecoder::BITDATA *data, FRAME &frame)
+{
+	const uint64_t bits = data->bitShifter;
+	uint16_t errors = data->validBitCtr >= FRAME_BITS ? 0 : INCOMPLETE_ERROR;
+	for (uint8_t i = 0; i < PARITY_GROUP_COUNT; i++)
+	{
+		const uint64_t group = (bits >> PARITY_GROUPS[i].startBit) & ((1ULL << PARITY_GROUPS[i].bitWidth) - 1);
+		errors |= __builtin_parityll(group) << i;
+	}
+	for (uint8_t i = 0; i < FIELD_COUNT; i++)
+	{
+		const uint8_t bcd = (bits >> FIELDS[i].startBit) & ((1U << FIELDS[i].bitWidth) - 1);
+		const uint8_t value = (bcd >> 4) * 10 + (bcd & 0xF);
+		errors |= ((value < FIELDS[i].lowestValue) | (value > FIELDS[i].highestValue)) << (RANGE_ERROR_SHIFT + i);
+		frame.*FIELDS[i].value = value;
+	}
+	frame.isSummerTime = bits & CEST_BIT;
+	frame.isWinterTime = bits & CET_BIT;
+	frame.timeZoneChangeAnnounced = bits & TIMEZONE_CHANGE_BIT;
+	return errors;
+}
+
+/**
+ * @brief Check and decode the fields of an incomplete minute frame, so that the fields can be used as soon as their bits have arrived.
+ * The fields are grouped by their parity bit : the minutes are complete at bit 28, the hours at bit 35 and the date at bit 58.
+ * @param data the bits received so far in the current minute, bit 0 is the first second of the minute
+ * @param frame receives the decoded fields.  Only the fields of the groups in the returned mask may be used.
+ * @returns MINUTE_FIELDS, HOUR_FIELDS and DATE_FIELDS for each group that is complete, has even parity and has all fields within range.
+ */
+uint8_t FrameDecoder::decodePartial(const SecondsDecoder::BITDATA *data, FRAME &frame)
+{
+	const uint64_t bits = data->bitShifter;
+	uint8_t validGroups = 0;
+	for (uint8_t i = 0; i < PARITY_GROUP_COUNT; i++)
+	{
+		const uint8_t endBit = PARITY_GROUPS[i].startBit + PARITY_GROUPS[i].bitWidth;
+		const uint64_t group = (bits >> PARITY_GROUPS[i].startBit) & ((1ULL << PARITY_GROUPS[i].bitWidth) - 1);
+		validGroups |= (data->validBitCtr >= endBit && !__builtin_parityll(group)) << i;
+	}
+	for (uint8_t i = 0; i < FIELD_COUNT; i++)
+	{
+		const uint8_t bcd = (bits >> FIELDS[i].startBit) & ((1U << FIELDS[i].bitWidth) - 1);
+		const uint8_t value = (bcd >> 4) * 10 + (bcd & 0xF);
+		frame.*FIELDS[i].value = value;
+		if (value < FIELDS[i].lowestValue || value > FIELDS[i].highestValue)
+		{
+			//Invalidate the parity group that holds this field
+			for (uint8_t j = 0; j < PARITY_GROUP_COUNT; j++)
+			{
+				if (FIELDS[i].startBit >= PARITY_GROUPS[j].startBit && FIELDS[i].startBit < PARITY_GROUPS[j].startBit + PARITY_GROUPS[j].bitWidth)
+				{
+					validGroups &= ~(1 << j);
+				}
+			}
+		}
+	}
+	frame.isSummerTime = bits & CEST_BIT;
+	frame.isWinterTime = bits & CET_BIT;
+	frame.timeZoneChangeAnnounced = bits & TIMEZONE_CHANGE_BIT;
+	return validGroups;
+}
+
+/**
+ * @brief Soft decision : a parity group that fails while it holds a single weak bit, is repaired by flipping that bit.  The pulse
+ * length of a weak bit was unclear, so it's by far the most likely bit to be wrong.  When a group holds more weak bits, the parity
+ * can't tell which one is wrong, and the group is left as it is.
+ * @param data the bits of a complete or partial minute.  Only the groups of which all bits have been received are repaired.
+ * @returns the number of bits that have been flipped
+ */
+uint8_t FrameDecoder::repairWeakBits(SecondsDecoder::BITDATA *data)
+{
+	uint8_t repaired = 0;
+	for (uint8_t i = 0; i < PARITY_GROUP_COUNT; i++)
+	{
+		const uint8_t endBit = PARITY_GROUPS[i].startBit + PARITY_GROUPS[i].bitWidth;
+		const uint64_t mask = ((1ULL << PARITY_GROUPS[i].bitWidth) - 1) << PARITY_GROUPS[i].startBit;
+		const uint64_t weak = data->weakBits & mask;
+		if (data->validBitCtr >= endBit && __builtin_parityll(data->bitShifter & mask) && weak && !(weak & (weak - 1)))
+		{
+			data->bitShifter ^= weak;
+			repaired++;
+		}
+	}
+	return repaired;
+}
+
+/**
+ * @brief Soft distance between the received bits and a frame, e.g. a predicted one.  Only the PREDICTABLE_BITS are compared : a
+ * weak bit that differs counts 1, any other bit that differs counts 2.
+ * @param data the bits of a complete minute
+ * @param frame the bits of the minute to compare with, as returned by encode()
+ */
+uint8_t FrameDecoder::distance(const SecondsDecoder::BITDATA *data, const uint64_t frame)
+{
+	const uint64_t diff = (data->bitShifter ^ frame) & PREDICTABLE_BITS;
+	return __builtin_popcountll(diff) + __builtin_popcountll(diff & ~data->weakBits);
+}
+
+/**
+ * @brief The opposite of decode() : build the minute frame that is transmitted for the given time.
+ * Bits that don't depend on the time (civil warnings, call bit, leap second) are left 0.
+ */
+uint64_t FrameDecoder::encode(const FRAME &frame)
+{
+	uint64_t bits = START_BIT;
+	bits |= frame.isSummerTime ? CEST_BIT : 0;
+	bits |= frame.isWinterTime ? CET_BIT : 0;
+	bits |= frame.timeZoneChangeAnnounced ? TIMEZONE_CHANGE_BIT : 0;
+	for (uint8_t i = 0; i < FIELD_COUNT; i++)
+	{
+		const uint8_t value = frame.*FIELDS[i].value;
+		bits |= (uint64_t)(((value / 10) << 4) | (value % 10)) << FIELDS[i].startBit;
+	}
+	for (uint8_t i = 0; i < PARITY_GROUP_COUNT; i++)
+	{
+		//The parity bit is the last bit of the group
+		const uint64_t group = (bits >> PARITY_GROUPS[i].startBit) & ((1ULL << PARITY_GROUPS[i].bitWidth) - 1);
+		bits |= (uint64_t)__builtin_parityll(group) << (PARITY_GROUPS[i].startBit + PARITY_GROUPS[i].bitWidth - 1);
+	}
+	return bits;
+}
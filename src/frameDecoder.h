@@ -0,0 +1,89 @@
+/*
+ * This file is part of RobustDcf.
+ * 
+ * RobustDcf is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Foobar is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Foobar.  If not, see <https://www.gnu.org/licenses/>.
+ * 
+ * Copyright Christoph Tack, 2018
+*/
+/* The FrameDecoder checks and decodes all fields of a complete DCF77 minute frame in a single pass.
+ * The layout of the frame is described by constant tables, so the compiler can unroll the loops and there are no branches
+ * per field.  It accepts exactly the frames that the BcdDecoders for minutes, hours, days, months and years together with
+ * BcdDecoder::dmyParityEven() accept.
+ */
+#pragma once
+#include "platform.h"
+#include "secondsDecoder.h"
+
+class FrameDecoder
+{
+public:
+	typedef struct
+	{
+		uint8_t minute;				//!<0-59
+		uint8_t hour;				//!<0-23
+		uint8_t day;				//!<1-31
+		uint8_t weekday;			//!<1 = monday, 7 = sunday.  Not checked, just like the BcdDecoders don't decode it.
+		uint8_t month;				//!<1-12
+		uint8_t year;				//!<0-99, year in the century
+		bool isSummerTime;			//!<CEST bit (17)
+		bool isWinterTime;			//!<CET bit (18)
+		bool timeZoneChangeAnnounced; //!<A1 bit (16)
+	} FRAME;
+	static const uint8_t MINUTE_FIELDS = 1;	 //!<the minutes and their parity are valid
+	static const uint8_t HOUR_FIELDS = 2;	 //!<the hours and their parity are valid
+	static const uint8_t DATE_FIELDS = 4;	 //!<day, weekday, month, year and their parity are valid
+	static const uint64_t PREDICTABLE_BITS = (1ULL << 17) | (1ULL << 18) | (((1ULL << 59) - 1) & ~((1ULL << 20) - 1)); //!<bits that only depend on the time
+	static const uint8_t PARITY_GROUP_COUNT = 3;
+	static const uint8_t FIELD_COUNT = 6;
+	static const uint16_t RANGE_ERROR_SHIFT = PARITY_GROUP_COUNT; //!<in the errors of decodeErrors(), the range error of field i is bit RANGE_ERROR_SHIFT + i
+	static const uint16_t INCOMPLETE_ERROR = 0x8000;			  //!<the frame has less than 59 bits
+	static bool decode(const SecondsDecoder::BITDATA *data, FRAME &frame);
+	static uint16_t decodeErrors(const SecondsDecoder::BITDATA *data, FRAME &frame);
+	static uint8_t decodePartial(const SecondsDecoder::BITDATA *data, FRAME &frame);
+	static uint64_t encode(const FRAME &frame);
+	static uint8_t repairWeakBits(SecondsDecoder::BITDATA *data);
+	static uint8_t distance(const SecondsDecoder::BITDATA *data, const uint64_t frame);
+
+private:
+	friend class BatchDecoder;
+	typedef struct
+	{
+		uint8_t startBit;
+		uint8_t bitWidth;
+		uint8_t lowestValue;
+		uint8_t highestValue;
+		uint8_t FRAME::*value;
+	} FIELD;
+	typedef struct
+	{
+		uint8_t startBit;
+		uint8_t bitWidth; //including the parity bit
+	} PARITY_GROUP;
+	static const uint8_t FRAME_BITS = 59;
+	static constexpr FIELD FIELDS[FIELD_COUNT] = {
+		{21, 7, 0, 59, &FRAME::minute},
+		{29, 6, 0, 23, &FRAME::hour},
+		{36, 6, 1, 31, &FRAME::day},
+		{42, 3, 0, 7, &FRAME::weekday},
+		{45, 5, 1, 12, &FRAME::month},
+		{50, 8, 0, 99, &FRAME::year}};
+	static constexpr PARITY_GROUP PARITY_GROUPS[PARITY_GROUP_COUNT] = {
+		{21, 8},   //minutes
+		{29, 7},   //hours
+		{36, 23}}; //date
+	static const uint64_t TIMEZONE_CHANGE_BIT = 1ULL << 16;
+	static const uint64_t CEST_BIT = 1ULL << 17;
+	static const uint64_t CET_BIT = 1ULL << 18;
+	static const uint64_t START_BIT = 1ULL << 20;
+};
@@ -0,0 +1,63 @@
+/*
+ * This file is part of RobustDcf.
+ * 
+ * RobustDcf is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Foobar is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Foobar.  If not, see <https://www.gnu.org/licenses/>.
+ * 
+ * Copyright Christoph Tack, 2018
+*/
+#ifndef ARDUINO
+#include "hostShim.h"
+
+static HostShim::sampleSource pinSource = nullptr;
+static uint32_t virtualMillis = 0;
+
+/**
+ * @brief Set the function that will be called to get the level of an input pin.
+ * When no sample source is set, all pins read LOW.
+ */
+void HostShim::setSampleSource(sampleSource source)
+{
+    pinSource = source;
+}
+
+/**
+ * @brief Set the virtual clock to an absolute value
+ */
+void HostShim::setMillis(uint32_t ms)
+{
+    virtualMillis = ms;
+}
+
+/**
+ * @brief Move the virtual clock forward.  Call this once for each sample that is fed to the decoder.
+ */
+void HostShim::advanceMillis(uint32_t ms)
+{
+    virtualMillis += ms;
+}
+
+void pinMode(uint8_t, uint8_t)
+{
+}
+
+int digitalRead(uint8_t pin)
+{
+    return pinSource ? pinSource(pin) : LOW;
+}
+
+uint32_t millis()
+{
+    return virtualMillis;
+}
+#endif
@@ -0,0 +1,60 @@
+/*
+ * This file is part of RobustDcf.
+ * 
+ * RobustDcf is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Foobar is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Foobar.  If not, see <https://www.gnu.org/licenses/>.
+ * 
+ * Copyright Christoph Tack, 2018
+*/
+/* Minimal replacement of the Arduino core for native (non-Arduino) builds.
+ * The pin level returned by digitalRead() comes from a user supplied sample source and millis() returns a virtual clock
+ * that is only advanced by the user.  This allows a recorded signal to be replayed through the decoder much faster than real time.
+ */
+#pragma once
+#ifndef ARDUINO
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <algorithm>
+
+typedef uint8_t byte;
+
+#define INPUT 0x0
+#define LOW 0x0
+#define HIGH 0x1
+
+using std::max;
+using std::min;
+
+namespace Chronos
+{
+typedef time_t EpochTime;
+}
+
+namespace HostShim
+{
+typedef uint8_t (*sampleSource)(uint8_t pin);
+void setSampleSource(sampleSource source);
+void setMillis(uint32_t ms);
+void advanceMillis(uint32_t ms);
+} // namespace HostShim
+
+//There are no interrupts on the host
+inline void noInterrupts() {}
+inline void interrupts() {}
+
+void pinMode(uint8_t pin, uint8_t mode);
+int digitalRead(uint8_t pin);
+uint32_t millis();
+#endif
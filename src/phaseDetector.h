@@ -20,9 +20,10 @@
  * Once the phase is found, it also returns the data from the stream : long/short pulse or no pulse at all (minute sync mark)
  */
 #pragma once
-#include "Arduino.h"
+#include "platform.h"
 #include "bin.h"
 #include "secondsDecoder.h"
+#include "ringBuffer.h"
 
 typedef enum
 {
@@ -33,36 +34,1047 @@ typedef enum
 
 
 
-typedef void (*event)(const bool isSync, const SECONDS_DATA pulseLength);
+typedef void (*event)(void *context, const bool isSync, const SECONDS_DATA pulseLength, const SOFT_PULSE soft);
 
-class PhaseDetector
+typedef struct
 {
+	uint32_t timestamp; //!<in µs
+	bool level;			//!<pin level after the edge
+} EDGE;
+
+/**
+ * @brief Input policy that reads a pin using digitalRead().  Works on every platform.
+ */
+class DigitalReadInput
+{
+public:
+	void begin(const byte pin)
+	{
+		_pin = pin;
+		pinMode(_pin, INPUT);
+	}
+	uint8_t read() const
+	{
+		return digitalRead(_pin);
+	}
+
+private:
+	byte _pin = 0;
+};
+
+#ifdef portInputRegister
+/**
+ * @brief Input policy that reads the input register of the GPIO-port directly.
+ * The register and the bit mask are looked up once, so reading a sample is a single load and mask.
+ */
+class PortRegisterInput
+{
+public:
+	void begin(const byte pin)
+	{
+		pinMode(pin, INPUT);
+		_port = portInputRegister(digitalPinToPort(pin));
+		_mask = digitalPinToBitMask(pin);
+	}
+	uint8_t read() const
+	{
+		return (*_port & _mask) ? 1 : 0;
+	}
+
+private:
+	decltype(portInputRegister(digitalPinToPort(0))) _port = nullptr;
+	uint32_t _mask = 0;
+};
+#endif
+
+/**
+ * @brief Common part of all phase detectors, so that the SysTick can sample all of them, whatever their configuration is.
+ */
+class PhaseDetectorBase
+{
+public:
+	PhaseDetectorBase();
+	virtual ~PhaseDetectorBase();
+	virtual void process_one_sample() = 0;
+	void detach();
+
+private:
+	friend void HAL_SYSTICK_Callback(void);
+	static PhaseDetectorBase *_firstDetector; //all instances, sampled by the SysTick
+	PhaseDetectorBase *_nextDetector = nullptr;
+};
+
+/**
+ * @brief The phase detector, configured at compile time.
+ * @tparam SAMPLE_FREQ number of samples per second
+ * @tparam BIN_COUNT number of bins per second.  Must divide SAMPLE_FREQ, with at most 31 samples per bin.
+ * @tparam InputPolicy how the input pins are read, e.g. DigitalReadInput or PortRegisterInput
+ */
+template <uint16_t SAMPLE_FREQ, uint8_t BIN_COUNT, class InputPolicy>
+class BasicPhaseDetector : public PhaseDetectorBase
+{
+	static_assert(SAMPLE_FREQ % BIN_COUNT == 0, "SAMPLE_FREQ must be a multiple of BIN_COUNT");
+	static_assert(SAMPLE_FREQ / BIN_COUNT < 32, "a bin must fit in a 32bit word of samples");
+	static_assert(BIN_COUNT >= 10 && BIN_COUNT < 255, "BIN_COUNT out of range");
+
 public:
-	PhaseDetector(const byte inputPin, bool pulseHighPolarity);
-	void init(event secondTickEvent);
-	void process_one_sample();
+	static const uint8_t MAX_RECEIVERS = 3;
+	BasicPhaseDetector(const byte inputPin, bool pulseHighPolarity);
+	BasicPhaseDetector(const byte *inputPins, const uint8_t *weights, const uint8_t receiverCount, bool pulseHighPolarity);
+	void init(event secondTickEvent, void *context = nullptr);
+	void process_one_sample() override;
+	void process_samples(const uint32_t *packedBits, const size_t nSamples);
+	void process_samples(const uint32_t *const *packedStreams, const size_t nSamples);
+	bool process_edge(const uint32_t timestamp, const bool level);
+	void process_edges(const uint32_t now);
+	bool process_one_bin();
+	void setLowPower(const bool enable);
+	bool isLowPower() const { return _lowPower; }
+	uint16_t getMillisSinceSecondStart();
+	uint32_t getMicrosSinceSecondStart();
+	uint32_t getPhase();
+	void getPeak(int32_t &peak, int32_t &margin);
+	uint16_t getDroppedBins() const { return _droppedBins; }
+	uint16_t getPhaseCorrections() const { return _phaseCorrections; }
+	uint32_t getSkippedBins() const { return _skippedBins; }
+	bool getPhaseState(int8_t *bins);
+	void presetPhase(const int8_t *bins, const uint16_t millisSinceSecondStart);
 
 private:
-	static const int BIN_COUNT = 100;
-	static const uint8_t INVALID = 255;
-	static const uint16_t SAMPLE_FREQ = 1000;
-	static const uint16_t SAMPLES_PER_BIN = SAMPLE_FREQ / BIN_COUNT;
-	static const uint16_t BINS_PER_10ms = BIN_COUNT / 100;
-	static const uint16_t BINS_PER_100ms = 10 * BINS_PER_10ms;
-	static const uint16_t BINS_PER_200ms = 20 * BINS_PER_10ms;
-	const uint32_t LOCK_THRESHOLD = 75;
-
-	uint8_t wrap(const uint8_t value);
+	friend class StageBench;
+	static constexpr uint8_t INVALID = 255;
+	static constexpr uint16_t SAMPLES_PER_BIN = SAMPLE_FREQ / BIN_COUNT;
+	static constexpr uint16_t BINS_PER_10ms = BIN_COUNT < 150 ? 1 : (BIN_COUNT + 50) / 100;
+	static constexpr uint16_t BINS_PER_100ms = (BIN_COUNT + 5) / 10;
+	static constexpr uint16_t BINS_PER_200ms = 2 * BINS_PER_100ms;
+	static constexpr uint16_t PEAK_TREE_LEAVES = nextPowerOfTwo(BIN_COUNT);
+	static constexpr uint8_t PENDING_BINS = 128; //bins that can wait for the deferred stage
+	static constexpr int32_t LOCK_THRESHOLD = 75 * BINS_PER_100ms / 10;
+	static constexpr uint32_t EDGE_CLOCK = 1000000;		//timestamps of the edges are in µs
+	static constexpr uint32_t MAX_EDGE_STEP = EDGE_CLOCK; //longest time between edges that is handled in one go, so that the scaled time fits in 32bit
+	static constexpr uint8_t PENDING_EDGES = 16;		//edges that can wait for the deferred stage
+	static constexpr uint8_t GUARD_BINS = 2 * BINS_PER_10ms;							   //low power : margin around the pulse window, for the phase to drift
+	static constexpr uint8_t LOW_POWER_WINDOW = BINS_PER_200ms + 2 * GUARD_BINS + 1;	   //low power : bins that are sampled each second
+	static constexpr uint8_t FULL_SCAN_INTERVAL = 60;								   //low power : seconds between full scans of all bins
+	static constexpr int32_t LOW_POWER_MARGIN = 8 * LOCK_THRESHOLD;					   //phase margin needed for low power
+	static constexpr uint8_t PRESET_SHIFT = 2;										   //presetPhase() : restored bins are scaled down, so that the signal soon overrules them
+	static constexpr uint8_t PHASE_FRACTION_BITS = 8;								   //fixed point fraction of the sub-bin phase
+	static constexpr int16_t ONE_BIN = 1 << PHASE_FRACTION_BITS;
+	static constexpr int16_t MIN_EDGE_ACTIVE = ONE_BIN / 8;							   //sub-bin phase : less active time means there's no pulse start
+	static constexpr uint8_t PHASE_FILTER_SHIFT = 3;								   //sub-bin phase : averaged over about 2^PHASE_FILTER_SHIFT seconds
+	static constexpr uint8_t PENDING_PHASE_SAMPLES = 4;
+	typedef struct
+	{
+		uint8_t pulseStartBin; //!<the bin where the pulse started when it was measured
+		uint16_t active;	   //!<active time of that bin and the one before it, in bins with PHASE_FRACTION_BITS fraction bits
+	} PHASE_SAMPLE;
+
+	uint8_t wrap(const uint16_t value);
+	void slideWindow();
+	void resyncWindow();
+	void initPeakTree();
+	void updatePeak(const uint8_t bin);
+	uint8_t peakOf(const uint16_t node);
 	bool phaseCorrelator();
-	void phase_binning(const FUZZY input);
-	void averager(const uint8_t sampled_data);
+	void phase_binning(const int8_t input);
+	void averager();
+	void queueVote(const int16_t vote);
+	uint32_t pendingBinCount();
+	void edgeBinning(const uint32_t timestamp);
+	void processBin(const int8_t vote);
+	bool inLowPowerWindow(const uint8_t bin);
+	void dutyCycle();
+	void leaveLowPower();
+	void recalculateCorrelation();
+	uint8_t windowPeak();
+	void measurePhase(const uint32_t activeTime, const uint32_t binTime);
+	void updateSubBinPhase(const PHASE_SAMPLE &sample);
 	void secondsSampler(const FUZZY averagedInput);
+	int8_t softDecision(const int pulseCtr);
 
-	byte _inputPin = 0;
+	byte _inputPins[MAX_RECEIVERS];
+	InputPolicy _inputs[MAX_RECEIVERS];
+	uint8_t _weights[MAX_RECEIVERS];
+	uint8_t _receiverCount = 0;
 	event _secondsEvent = nullptr;
-	Bin _bin; //100bins, each holding for 10ms of data
+	void *_secondsContext = nullptr; //passed to _secondsEvent
+	Bin<BIN_COUNT, INT8_MIN> _bin; //100bins, each holding for 10ms of data
 	bool _pulseActiveHigh;
-	uint32_t _phaseCorrelation[BIN_COUNT];
+	int32_t _phaseCorrelation[PEAK_TREE_LEAVES]; //entries beyond BIN_COUNT are padding and remain 0
+	uint8_t _peakTree[PEAK_TREE_LEAVES];		 //tournament tree : each node holds the bin of the highest correlation below it
+	int32_t _windowSum[2] = {0, 0};				 //sum of the bins in 0->100ms and 100ms->200ms after _activeBin, offset to unsigned
 	uint8_t _activeBin = 0;
 	uint8_t _pulseStartBin = INVALID;
+	uint8_t _sampleCtr = 0;				  //number of samples in _average
+	uint8_t _average[MAX_RECEIVERS];	  //for each receiver, the number of active samples in the current bin
+	RingBuffer<int8_t, PENDING_BINS> _pendingBins; //votes of the completed bins, waiting for the deferred stage
+	byte _samplerState = 0;				  //secondsSampler state
+	int _pulseCtr = 0;					  //secondsSampler integrated input during the current interval
+	bool _syncMark = false;				  //secondsSampler result of the sync mark interval
+	int8_t _syncSoft = 0;				  //secondsSampler soft decision of the sync mark interval
+	byte _currentSecondPulseStart = 0;	  //secondsSampler pulse start of the second being measured
+	volatile uint16_t _droppedBins = 0;	  //bins that didn't fit in the queue, since power up
+	volatile uint32_t _unqueuedBins = 0;  //ISR : dropped bins that still have to be queued as votes of 0
+	uint16_t _phaseCorrections = 0;		  //moves of _pulseStartBin after the lock, since power up
+	RingBuffer<EDGE, PENDING_EDGES> _pendingEdges; //edges captured by the ISR, waiting for process_edges()
+	uint32_t _edgeTime = 0;						   //timestamp up to which the edges have been binned
+	uint32_t _edgeBinPos = 0;					   //time binned in the current bin, in µs * BIN_COUNT
+	uint32_t _edgeActiveTime = 0;				   //time the pulse was active in the current bin, in µs * BIN_COUNT
+	bool _edgeActive = false;					   //the pulse is active since the last edge
+	bool _edgesStarted = false;					   //_edgeTime is valid
+	bool _lowPowerEnabled = false;				   //setLowPower()
+	volatile bool _lowPower = false;			   //only the bins around the pulse are sampled and correlated
+	bool _skipBin = false;						   //ISR : the bin that's being sampled is outside the low power window
+	uint8_t _sampledBin = 1;					   //ISR : the bin that's being sampled.  The deferred stage will process it as _activeBin.
+	uint8_t _lowPowerSeconds = 0;				   //seconds since low power started
+	bool _windowStale = false;					   //_windowSum missed the bins that have been skipped
+	uint32_t _skippedBins = 0;					   //bins skipped in low power, since power up
+	PHASE_SAMPLE _phaseSample = {INVALID, 0};	   //ISR : sub-bin phase measurement that's being sampled
+	RingBuffer<PHASE_SAMPLE, PENDING_PHASE_SAMPLES> _phaseSamples; //sub-bin phase measurements, waiting for the deferred stage
+	int16_t _subBinPhase = 0;					   //start of the pulse, from the start of _pulseStartBin, in bins with PHASE_FRACTION_BITS fraction bits
+	uint8_t _subBinSamples = 0;					   //measurements in _subBinPhase, up to 2^PHASE_FILTER_SHIFT
 };
+
+template <uint16_t SAMPLE_FREQ, uint8_t BIN_COUNT, class InputPolicy>
+BasicPhaseDetector<SAMPLE_FREQ, BIN_COUNT, InputPolicy>::BasicPhaseDetector(const byte inputPin, bool pulseHighPolarity) : BasicPhaseDetector(&inputPin, nullptr, 1, pulseHighPolarity)
+{
+}
+
+/**
+ * @brief Antenna diversity : the signals of multiple receivers are combined in a single phase detector.
+ * Each 10ms, the vote of each receiver is multiplied by its weight and the sum of these is added to the bin.
+ * Receivers that are known to be better can get a higher weight.  A receiver with weight 0 is ignored.
+ * @param inputPins the input pins of the receivers
+ * @param weights weight for each receiver, or nullptr to give all receivers the same weight
+ * @param receiverCount number of receivers, at most MAX_RECEIVERS
+ */
+template <uint16_t SAMPLE_FREQ, uint8_t BIN_COUNT, class InputPolicy>
+BasicPhaseDetector<SAMPLE_FREQ, BIN_COUNT, InputPolicy>::BasicPhaseDetector(const byte *inputPins, const uint8_t *weights, const uint8_t receiverCount, bool pulseHighPolarity) : _receiverCount(receiverCount < MAX_RECEIVERS ? receiverCount : MAX_RECEIVERS),
+																																	_pulseActiveHigh(pulseHighPolarity)
+{
+	for (uint8_t i = 0; i < _receiverCount; i++)
+	{
+		_inputPins[i] = inputPins[i];
+		_weights[i] = weights ? weights[i] : 1;
+	}
+}
+
+/**
+ * @brief Restart the detector.
+ * @param secondTickEvent called by the deferred stage at each second tick
+ * @param context passed to secondTickEvent, e.g. the object that handles it
+ */
+template <uint16_t SAMPLE_FREQ, uint8_t BIN_COUNT, class InputPolicy>
+void BasicPhaseDetector<SAMPLE_FREQ, BIN_COUNT, InputPolicy>::init(event secondTickEvent, void *context)
+{
+	for (uint8_t i = 0; i < _receiverCount; i++)
+	{
+		_inputs[i].begin(_inputPins[i]);
+	}
+	_secondsEvent = secondTickEvent;
+	_secondsContext = context;
+
+	//clear local variables
+	_bin.clear();
+	memset(_phaseCorrelation, 0, sizeof(_phaseCorrelation));
+	initPeakTree();
+	_activeBin = 0;
+	resyncWindow();
+	_sampleCtr = 0;
+	memset(_average, 0, sizeof(_average));
+	_pendingBins.clear();
+	_unqueuedBins = 0;
+	_pulseStartBin = INVALID;
+	_samplerState = 0;
+	_pulseCtr = 0;
+	_syncMark = false;
+	_syncSoft = 0;
+	_pendingEdges.clear();
+	_edgeBinPos = _edgeActiveTime = 0;
+	_edgesStarted = false;
+	_lowPower = false;
+	_skipBin = false;
+	_sampledBin = 1;
+	_lowPowerSeconds = 0;
+	_windowStale = false;
+	_phaseSample.pulseStartBin = INVALID;
+	_phaseSamples.clear();
+	_subBinPhase = 0;
+	_subBinSamples = 0;
+}
+
+/**
+ * @brief Low power mode : once the phase is locked with a clear margin, only the bins around the pulse are sampled and correlated.
+ * That's about a quarter of each second.  Once a minute, all bins are scanned for a second to verify the phase.
+ * When the phase margin drops or the lock is lost, all bins are sampled again until the lock is clear.
+ * The pins are only read when sampled by the SysTick.  With process_samples() or edges, the bins outside the window are ignored.
+ */
+template <uint16_t SAMPLE_FREQ, uint8_t BIN_COUNT, class InputPolicy>
+void BasicPhaseDetector<SAMPLE_FREQ, BIN_COUNT, InputPolicy>::setLowPower(const bool enable)
+{
+	_lowPowerEnabled = enable;
+	if (!enable && _lowPower)
+	{
+		leaveLowPower();
+	}
+}
+
+/**
+ * @brief Sample data to check if a short/long tick is in the current second and if there's a minute sync mark (no pulse at all).
+ * This function can generate an event every second, containing the pin status : sync or not, long or short pulse, and the
+ * soft decisions they have been derived from
+ * @param averagedInput input pin value, averaged over the last 10ms
+ */
+template <uint16_t SAMPLE_FREQ, uint8_t BIN_COUNT, class InputPolicy>
+void BasicPhaseDetector<SAMPLE_FREQ, BIN_COUNT, InputPolicy>::secondsSampler(const FUZZY averagedInput)
+{
+	const int ZERO_ONE_THRESHOLD = BINS_PER_100ms / 2; //threshold for discriminating between a one and a zero bit.
+
+	switch (_samplerState)
+	{
+	case 0:
+		if (wrap(BIN_COUNT + _pulseStartBin - _activeBin) <= BINS_PER_10ms || wrap((BIN_COUNT + _activeBin - _pulseStartBin)) <= BINS_PER_100ms)
+		{
+			//We entered the measurement interval : Start sampling <10ms before pulse start to <100ms after pulse start
+			_samplerState = 1;
+			_pulseCtr = averagedInput;
+			_currentSecondPulseStart = _pulseStartBin;
+		}
+		break;
+	case 1:
+		//Check what the most occurring inputpin value was from 10ms before the start of the pulse up to 100ms later.
+		//This where the sync mark is located in case it's present
+		_pulseCtr += averagedInput;
+		if (wrap(_currentSecondPulseStart + BINS_PER_100ms) == _activeBin)
+		{
+			_samplerState = 2;
+			_syncMark = _pulseCtr < -BINS_PER_100ms ? true : false;
+			_syncSoft = softDecision(-_pulseCtr);
+			_pulseCtr = 0;
+		}
+		break;
+	case 2:
+		//Check what the most occurring inputpin value was from 100ms after the start of the pulse up to 200ms later.
+		//This is where the the difference between a short and a long pulse can be detected.
+		_pulseCtr += averagedInput;
+		if (wrap(_currentSecondPulseStart + BINS_PER_200ms + BINS_PER_10ms) == _activeBin)
+		{
+			_samplerState = 0;
+			if (_secondsEvent)
+			{
+				SECONDS_DATA pulseLength = _pulseCtr >= ZERO_ONE_THRESHOLD ? LONGPULSE : _pulseCtr <= -ZERO_ONE_THRESHOLD ? SHORTPULSE
+																													  : UNKNOWNPULSE;
+				//A syncMark should normally be accompanied by a SHORTPULSE.
+				_secondsEvent(_secondsContext, _syncMark, pulseLength, {_syncSoft, softDecision(_pulseCtr)});
+			}
+		}
+		break;
+	}
+}
+
+/**
+ * @brief Scale the integrated input of a 100ms interval to a soft decision, from -SOFT_SCALE to SOFT_SCALE.
+ */
+template <uint16_t SAMPLE_FREQ, uint8_t BIN_COUNT, class InputPolicy>
+int8_t BasicPhaseDetector<SAMPLE_FREQ, BIN_COUNT, InputPolicy>::softDecision(const int pulseCtr)
+{
+	const int soft = pulseCtr * SOFT_SCALE / BINS_PER_100ms;
+	return soft > SOFT_SCALE ? SOFT_SCALE : (soft < -SOFT_SCALE ? -SOFT_SCALE : soft);
+}
+
+// faster modulo function which avoids division
+// returns value % bin_count, for values < 2 * bin_count
+// When BIN_COUNT is a power of two, this is a mask.  Otherwise it's a single compare.
+template <uint16_t SAMPLE_FREQ, uint8_t BIN_COUNT, class InputPolicy>
+uint8_t BasicPhaseDetector<SAMPLE_FREQ, BIN_COUNT, InputPolicy>::wrap(const uint16_t value)
+{
+	if (!(BIN_COUNT & (BIN_COUNT - 1)))
+	{
+		return value & (BIN_COUNT - 1);
+	}
+	return value >= BIN_COUNT ? value - BIN_COUNT : value;
+}
+
+/**
+ * @brief Move the correlation window one bin further, so that it starts at _activeBin again.
+ * Only the bins that enter and leave the windows have to be accounted for.
+ */
+template <uint16_t SAMPLE_FREQ, uint8_t BIN_COUNT, class InputPolicy>
+void BasicPhaseDetector<SAMPLE_FREQ, BIN_COUNT, InputPolicy>::slideWindow()
+{
+	const uint8_t previousBin = wrap(_activeBin + BIN_COUNT - 1);
+	const uint8_t middleBin = wrap(previousBin + BINS_PER_100ms);
+	const uint8_t endBin = wrap(previousBin + BINS_PER_200ms);
+	_windowSum[0] += _bin.get(middleBin) - _bin.get(previousBin);
+	_windowSum[1] += _bin.get(endBin) - _bin.get(middleBin);
+}
+
+/**
+ * @brief Calculate the window sums from scratch.
+ */
+template <uint16_t SAMPLE_FREQ, uint8_t BIN_COUNT, class InputPolicy>
+void BasicPhaseDetector<SAMPLE_FREQ, BIN_COUNT, InputPolicy>::resyncWindow()
+{
+	_windowSum[0] = _windowSum[1] = 0;
+	for (uint8_t bin = 0; bin < BINS_PER_100ms; ++bin)
+	{
+		_windowSum[0] += _bin.get(wrap(_activeBin + bin)) + 128;
+		_windowSum[1] += _bin.get(wrap(_activeBin + BINS_PER_100ms + bin)) + 128;
+	}
+}
+
+/**
+ * @brief Build the tournament tree over _phaseCorrelation.  Node 1 is the root, the children of node n are 2n and 2n+1.
+ * Nodes from PEAK_TREE_LEAVES onwards are the leaves, i.e. the correlation bins themselves.
+ */
+template <uint16_t SAMPLE_FREQ, uint8_t BIN_COUNT, class InputPolicy>
+void BasicPhaseDetector<SAMPLE_FREQ, BIN_COUNT, InputPolicy>::initPeakTree()
+{
+	for (uint16_t node = PEAK_TREE_LEAVES - 1; node > 0; --node)
+	{
+		_peakTree[node] = peakOf(node);
+	}
+}
+
+/**
+ * @brief Return the bin with the highest correlation of the two children of a tree node.
+ * On equal correlation, the lowest bin wins.
+ */
+template <uint16_t SAMPLE_FREQ, uint8_t BIN_COUNT, class InputPolicy>
+uint8_t BasicPhaseDetector<SAMPLE_FREQ, BIN_COUNT, InputPolicy>::peakOf(const uint16_t node)
+{
+	const uint16_t left = node << 1;
+	const uint16_t right = left + 1;
+	const uint8_t leftPeak = left >= PEAK_TREE_LEAVES ? left - PEAK_TREE_LEAVES : _peakTree[left];
+	const uint8_t rightPeak = right >= PEAK_TREE_LEAVES ? right - PEAK_TREE_LEAVES : _peakTree[right];
+	return _phaseCorrelation[rightPeak] > _phaseCorrelation[leftPeak] ? rightPeak : leftPeak;
+}
+
+/**
+ * @brief The correlation of a bin has changed.  Replay the matches on the path from that bin to the root of the tree.
+ */
+template <uint16_t SAMPLE_FREQ, uint8_t BIN_COUNT, class InputPolicy>
+void BasicPhaseDetector<SAMPLE_FREQ, BIN_COUNT, InputPolicy>::updatePeak(const uint8_t bin)
+{
+	for (uint16_t node = (PEAK_TREE_LEAVES + bin) >> 1; node > 0; node >>= 1)
+	{
+		_peakTree[node] = peakOf(node);
+	}
+}
+
+/**
+ * @brief The correlation is used to find the window of maximum signal match with the predefined template:
+ * 0 -> 100ms : high (start of pulse)
+ * 100ms -> 200ms : either high or low, depending of long or short pulse
+ * 200ms -> 1000ms : low
+ * The window sums are kept up to date by phase_binning(), so the correlation of the active bin is available immediately.
+ * The bin with the highest correlation is tracked in a tournament tree, so the cost doesn't grow with BIN_COUNT.
+ * @returns true when the phaseCorrelator is locked.  I.e. the correlation peak is higher than the LOCK_THRESHOLD.
+ */
+template <uint16_t SAMPLE_FREQ, uint8_t BIN_COUNT, class InputPolicy>
+bool BasicPhaseDetector<SAMPLE_FREQ, BIN_COUNT, InputPolicy>::phaseCorrelator()
+{
+	//Correlate with the template
+	_phaseCorrelation[_activeBin] = (_windowSum[0] << 1) + _windowSum[1];
+
+	//Find bin where correlation is maximum.  In low power, only the bins near the pulse start are up to date.
+	if (!_lowPower)
+	{
+		updatePeak(_activeBin);
+	}
+	byte highestCorrelationBin = _lowPower ? windowPeak() : _peakTree[1];
+	if (highestCorrelationBin == INVALID)
+	{
+		//The peak may be outside the window
+		leaveLowPower();
+		highestCorrelationBin = _peakTree[1];
+	}
+	if (_phaseCorrelation[highestCorrelationBin] <= LOCK_THRESHOLD)
+	{
+		//no lock
+		if (_lowPower)
+		{
+			leaveLowPower();
+		}
+		return false;
+	}
+	if (_pulseStartBin == INVALID)
+	{
+		//if not yet initialized, set correct bin directly.
+		_pulseStartBin = highestCorrelationBin;
+		_subBinPhase = 0;
+		_subBinSamples = 0;
+	}
+	else
+	{
+		//Move the bin where the pulse starts closer to the bin with currently the highest match
+		if (wrap(BIN_COUNT + _pulseStartBin - highestCorrelationBin) > (BIN_COUNT >> 1))
+		{
+			_pulseStartBin = wrap(_pulseStartBin + 1);
+			_subBinPhase -= ONE_BIN;
+			_phaseCorrections++;
+		}
+		else if (_pulseStartBin != highestCorrelationBin)
+		{
+			_pulseStartBin = wrap(_pulseStartBin + BIN_COUNT - 1);
+			_subBinPhase += ONE_BIN;
+			_phaseCorrections++;
+		}
+	}
+	return true;
+}
+
+/**
+ * @brief Add the averaged sample to the correct bin.
+ * This function gets called every 10ms.
+ * @param input the weighted sum of the most occuring pin state of each receiver, sampled over the last 10ms
+ */
+template <uint16_t SAMPLE_FREQ, uint8_t BIN_COUNT, class InputPolicy>
+void BasicPhaseDetector<SAMPLE_FREQ, BIN_COUNT, InputPolicy>::phase_binning(const int8_t input)
+{
+	_activeBin = (_activeBin < BIN_COUNT - 1) ? _activeBin + 1 : 0;
+	if (_windowStale)
+	{
+		resyncWindow();
+		_windowStale = false;
+	}
+	else
+	{
+		slideWindow();
+	}
+
+	if (!input)
+	{
+		return;
+	}
+	const int32_t oldValue = _bin.get(_activeBin);
+	if (_bin.add(_activeBin, input))
+	{
+		//Saturated bin : all other bins have been decreased by the input value
+		_windowSum[0] -= input * (BINS_PER_100ms - 1);
+		_windowSum[1] -= input * BINS_PER_100ms;
+	}
+	//The active bin is the first bin of the 0->100ms window
+	_windowSum[0] += _bin.get(_activeBin) - oldValue;
+}
+
+/**
+ * @brief Find the symbol that occurs most (0 or 1) every 10 samples.
+ * This function gets called every ms, after the samples of all receivers have been added to _average.
+ * Once the bin is complete, the averaged samples of all receivers are combined and queued for the deferred stage.
+ * When the deferred stage can't keep up and the queue is full, the bin is dropped.
+ */
+template <uint16_t SAMPLE_FREQ, uint8_t BIN_COUNT, class InputPolicy>
+void BasicPhaseDetector<SAMPLE_FREQ, BIN_COUNT, InputPolicy>::averager()
+{
+	if (++_sampleCtr < SAMPLES_PER_BIN)
+	{
+		return;
+	}
+	int16_t vote = 0;
+	uint16_t activeTime = 0, totalWeight = 0;
+	for (uint8_t i = 0; i < _receiverCount && !_skipBin; i++)
+	{
+		// Once sinked and the signal is clear, the average will be either 0 or SAMPLES_PER_BIN.
+		const FUZZY input = _average[i] * 10 < 3 * SAMPLES_PER_BIN ? LOWV : (_average[i] * 10 > 7 * SAMPLES_PER_BIN ? HIGHV : DONTKNOW);
+		vote += _weights[i] * input;
+		activeTime += _weights[i] * _average[i];
+		totalWeight += _weights[i];
+		_average[i] = 0;
+	}
+	measurePhase(activeTime, totalWeight * SAMPLES_PER_BIN);
+	queueVote(vote);
+	_sampleCtr = 0;
+}
+
+/**
+ * @brief Queue the vote of a complete bin for the deferred stage.
+ */
+template <uint16_t SAMPLE_FREQ, uint8_t BIN_COUNT, class InputPolicy>
+void BasicPhaseDetector<SAMPLE_FREQ, BIN_COUNT, InputPolicy>::queueVote(const int16_t vote)
+{
+	_sampledBin = wrap(_sampledBin + 1);
+	//Bins that didn't fit are queued as votes of 0 once there's room again, so that the deferred stage keeps counting the bins
+	//of the second.  Their data is lost, but the phase doesn't shift.
+	while (_unqueuedBins && _pendingBins.push(0))
+	{
+		_unqueuedBins--;
+	}
+	if (_unqueuedBins || !_pendingBins.push(vote > INT8_MAX ? INT8_MAX : vote < -INT8_MAX ? -INT8_MAX : vote))
+	{
+		_droppedBins++;
+		_unqueuedBins++;
+	}
+}
+
+/**
+ * @brief Bins that have been sampled, but not processed by the deferred stage yet
+ */
+template <uint16_t SAMPLE_FREQ, uint8_t BIN_COUNT, class InputPolicy>
+uint32_t BasicPhaseDetector<SAMPLE_FREQ, BIN_COUNT, InputPolicy>::pendingBinCount()
+{
+	return _pendingBins.size() + _unqueuedBins;
+}
+
+/**
+ * @brief Deferred stage : process the oldest pending bin.  Call this from the main loop until it returns false.
+ * The second tick event is called from here, not from the ISR.
+ * @returns false when there are no pending bins
+ */
+template <uint16_t SAMPLE_FREQ, uint8_t BIN_COUNT, class InputPolicy>
+bool BasicPhaseDetector<SAMPLE_FREQ, BIN_COUNT, InputPolicy>::process_one_bin()
+{
+	int8_t vote;
+	if (!_pendingBins.pop(vote))
+	{
+		return false;
+	}
+	PHASE_SAMPLE sample;
+	while (_phaseSamples.pop(sample))
+	{
+		updateSubBinPhase(sample);
+	}
+	processBin(vote);
+	return true;
+}
+
+/**
+ * @brief Age of the second that has been reported by the last seconds event, in sample time : the bins since the start of the
+ * pulse, including the bins that are still waiting for the deferred stage and the samples of the incomplete bin.
+ * Only meaningful when called from the seconds event or right after it, as it wraps around after a second.
+ */
+template <uint16_t SAMPLE_FREQ, uint8_t BIN_COUNT, class InputPolicy>
+uint16_t BasicPhaseDetector<SAMPLE_FREQ, BIN_COUNT, InputPolicy>::getMillisSinceSecondStart()
+{
+	const uint16_t bins = wrap(BIN_COUNT + _activeBin - _currentSecondPulseStart) + 1 + pendingBinCount();
+	return (uint32_t)(bins * SAMPLES_PER_BIN + _sampleCtr) * 1000 / SAMPLE_FREQ;
+}
+
+/**
+ * @brief Same as above, in µs and with a resolution better than a bin : the start of the pulse within its bin is measured from the
+ * samples and averaged over the seconds.
+ */
+template <uint16_t SAMPLE_FREQ, uint8_t BIN_COUNT, class InputPolicy>
+uint32_t BasicPhaseDetector<SAMPLE_FREQ, BIN_COUNT, InputPolicy>::getMicrosSinceSecondStart()
+{
+	const uint16_t bins = wrap(BIN_COUNT + _activeBin - _currentSecondPulseStart) + 1 + pendingBinCount();
+	//The pulse start may have moved by a bin since the start of the second
+	const uint8_t moved = _pulseStartBin == INVALID ? 0 : wrap(BIN_COUNT + _pulseStartBin - _currentSecondPulseStart);
+	const int32_t offset = _subBinPhase + (moved > (BIN_COUNT >> 1) ? moved - BIN_COUNT : moved) * ONE_BIN;
+	return bins * (1000000UL / BIN_COUNT) + _sampleCtr * (1000000UL / SAMPLE_FREQ) - offset * (int32_t)(1000000L / BIN_COUNT) / ONE_BIN;
+}
+
+/**
+ * @brief Where the pulse starts within the second, counted from the start of bin 0, in ms with PHASE_FRACTION_BITS fraction bits.
+ * Bin 0 starts one bin before the first sample after init().
+ * @returns UINT32_MAX when the phase isn't locked
+ */
+template <uint16_t SAMPLE_FREQ, uint8_t BIN_COUNT, class InputPolicy>
+uint32_t BasicPhaseDetector<SAMPLE_FREQ, BIN_COUNT, InputPolicy>::getPhase()
+{
+	if (_pulseStartBin == INVALID)
+	{
+		return UINT32_MAX;
+	}
+	const int32_t bins = (int32_t)_pulseStartBin * ONE_BIN + _subBinPhase;
+	const int32_t second = (int32_t)BIN_COUNT * ONE_BIN;
+	return (uint32_t)((bins + second) % second) * 1000 / BIN_COUNT;
+}
+
+/**
+ * @brief Called by the ISR for each complete bin, before it's queued : the active time of the bin before the pulse start and of the
+ * bin where the pulse starts is passed to the deferred stage.  Their sum is the time from the start of the pulse up to the end of
+ * its bin, with the resolution of a sample instead of a bin.
+ * @param activeTime time that the pulse was active in the bin
+ * @param binTime length of the bin, in the same unit
+ */
+template <uint16_t SAMPLE_FREQ, uint8_t BIN_COUNT, class InputPolicy>
+void BasicPhaseDetector<SAMPLE_FREQ, BIN_COUNT, InputPolicy>::measurePhase(const uint32_t activeTime, const uint32_t binTime)
+{
+	const uint8_t pulseStartBin = _pulseStartBin;
+	if (pulseStartBin == INVALID || !binTime)
+	{
+		return;
+	}
+	if (_sampledBin == wrap(pulseStartBin + BIN_COUNT - 1))
+	{
+		_phaseSample = {pulseStartBin, (uint16_t)(activeTime * ONE_BIN / binTime)};
+	}
+	else if (_sampledBin == pulseStartBin && _phaseSample.pulseStartBin == pulseStartBin)
+	{
+		_phaseSample.active += activeTime * ONE_BIN / binTime;
+		_phaseSamples.push(_phaseSample);
+		_phaseSample.pulseStartBin = INVALID;
+	}
+}
+
+/**
+ * @brief Deferred stage : average the position of the pulse start within its bin over the seconds.  Seconds without a pulse
+ * start near the bin, like the sync mark, are left out.  Noise pulls the position towards the start of the bin, by the ratio
+ * of flipped samples.
+ */
+template <uint16_t SAMPLE_FREQ, uint8_t BIN_COUNT, class InputPolicy>
+void BasicPhaseDetector<SAMPLE_FREQ, BIN_COUNT, InputPolicy>::updateSubBinPhase(const PHASE_SAMPLE &sample)
+{
+	if (sample.pulseStartBin != _pulseStartBin || sample.active < MIN_EDGE_ACTIVE || sample.active > 2 * ONE_BIN - MIN_EDGE_ACTIVE)
+	{
+		return;
+	}
+	const int16_t offset = ONE_BIN - sample.active;
+	if (_subBinSamples < (1 << PHASE_FILTER_SHIFT))
+	{
+		_subBinSamples++;
+	}
+	_subBinPhase += (offset - _subBinPhase) / _subBinSamples;
+}
+
+/**
+ * @brief Signal quality of the phase lock.  Not meant for the ISR : it scans all bins.
+ * @param peak correlation of the best matching bin.  The phase is locked when it's higher than LOCK_THRESHOLD.
+ * @param margin peak minus the highest correlation more than 100ms away from the peak, i.e. the best alternative phase.
+ */
+template <uint16_t SAMPLE_FREQ, uint8_t BIN_COUNT, class InputPolicy>
+void BasicPhaseDetector<SAMPLE_FREQ, BIN_COUNT, InputPolicy>::getPeak(int32_t &peak, int32_t &margin)
+{
+	const uint8_t peakBin = _peakTree[1];
+	int32_t runnerUp = INT32_MIN;
+	for (uint8_t i = 0; i < BIN_COUNT; i++)
+	{
+		const uint8_t distance = wrap(BIN_COUNT + i - peakBin);
+		if (distance > BINS_PER_100ms && distance < BIN_COUNT - BINS_PER_100ms && _phaseCorrelation[i] > runnerUp)
+		{
+			runnerUp = _phaseCorrelation[i];
+		}
+	}
+	peak = _phaseCorrelation[peakBin];
+	margin = peak - runnerUp;
+}
+
+/**
+ * @brief Pass the combined vote of the receivers to the binning, the correlator and the seconds sampler.
+ */
+template <uint16_t SAMPLE_FREQ, uint8_t BIN_COUNT, class InputPolicy>
+void BasicPhaseDetector<SAMPLE_FREQ, BIN_COUNT, InputPolicy>::processBin(const int8_t vote)
+{
+	const uint8_t nextBin = wrap(_activeBin + 1);
+	if (_pulseStartBin != INVALID && nextBin == wrap(BIN_COUNT + _pulseStartBin - GUARD_BINS))
+	{
+		dutyCycle();
+	}
+	if (_lowPower && !inLowPowerWindow(nextBin))
+	{
+		_activeBin = nextBin;
+		_windowStale = true;
+		_skippedBins++;
+		return;
+	}
+	phase_binning(vote);
+	if (phaseCorrelator())
+	{
+		secondsSampler(vote > 0 ? HIGHV : (vote < 0 ? LOWV : DONTKNOW));
+	}
+}
+
+/**
+ * @brief Low power : is the bin in the window that is sampled, i.e. from GUARD_BINS before the pulse start up to GUARD_BINS
+ * after the end of a long pulse.
+ */
+template <uint16_t SAMPLE_FREQ, uint8_t BIN_COUNT, class InputPolicy>
+bool BasicPhaseDetector<SAMPLE_FREQ, BIN_COUNT, InputPolicy>::inLowPowerWindow(const uint8_t bin)
+{
+	return wrap(BIN_COUNT + bin - wrap(BIN_COUNT + _pulseStartBin - GUARD_BINS)) < LOW_POWER_WINDOW;
+}
+
+/**
+ * @brief Called each second at the start of the low power window : switch between low power and full scans.
+ */
+template <uint16_t SAMPLE_FREQ, uint8_t BIN_COUNT, class InputPolicy>
+void BasicPhaseDetector<SAMPLE_FREQ, BIN_COUNT, InputPolicy>::dutyCycle()
+{
+	if (!_lowPowerEnabled)
+	{
+		return;
+	}
+	if (_lowPower)
+	{
+		if (++_lowPowerSeconds >= FULL_SCAN_INTERVAL)
+		{
+			//Scan all bins for a second
+			leaveLowPower();
+		}
+		return;
+	}
+	int32_t peak, margin;
+	getPeak(peak, margin);
+	if (peak > LOCK_THRESHOLD && margin >= LOW_POWER_MARGIN)
+	{
+		_lowPower = true;
+		_lowPowerSeconds = 0;
+	}
+}
+
+/**
+ * @brief Back to sampling and correlating all bins.  The correlation outside the window and the peak tree are outdated, so these
+ * are calculated again from the bins as they are now.
+ * The bins outside the window have been moved by the saturation of the bins inside, without being limited to 8bit by a vote
+ * of their own.  Adding 0 limits them.
+ */
+template <uint16_t SAMPLE_FREQ, uint8_t BIN_COUNT, class InputPolicy>
+void BasicPhaseDetector<SAMPLE_FREQ, BIN_COUNT, InputPolicy>::leaveLowPower()
+{
+	_lowPower = false;
+	for (uint8_t bin = 0; bin < BIN_COUNT; bin++)
+	{
+		if (!inLowPowerWindow(bin))
+		{
+			_bin.add(bin, 0);
+		}
+	}
+	recalculateCorrelation();
+}
+
+/**
+ * @brief Calculate the correlation of all bins and the peak tree again from the bins as they are now.
+ */
+template <uint16_t SAMPLE_FREQ, uint8_t BIN_COUNT, class InputPolicy>
+void BasicPhaseDetector<SAMPLE_FREQ, BIN_COUNT, InputPolicy>::recalculateCorrelation()
+{
+	const uint8_t activeBin = _activeBin;
+	_activeBin = 0;
+	resyncWindow();
+	for (uint8_t bin = 0; bin < BIN_COUNT; bin++)
+	{
+		if (bin)
+		{
+			_activeBin = bin;
+			slideWindow();
+		}
+		_phaseCorrelation[bin] = (_windowSum[0] << 1) + _windowSum[1];
+	}
+	_activeBin = activeBin;
+	resyncWindow();
+	_windowStale = false;
+	initPeakTree();
+}
+
+/**
+ * @brief Snapshot of the phase histogram, e.g. to be stored before powering down.
+ * @param bins receives BIN_COUNT values, starting at the bin where the pulse starts
+ * @returns false when the phase isn't locked, bins is left untouched then.
+ */
+template <uint16_t SAMPLE_FREQ, uint8_t BIN_COUNT, class InputPolicy>
+bool BasicPhaseDetector<SAMPLE_FREQ, BIN_COUNT, InputPolicy>::getPhaseState(int8_t *bins)
+{
+	if (_pulseStartBin == INVALID)
+	{
+		return false;
+	}
+	for (uint8_t i = 0; i < BIN_COUNT; i++)
+	{
+		const int32_t value = _bin.get(wrap(_pulseStartBin + i));
+		bins[i] = value < INT8_MIN ? INT8_MIN : (value > INT8_MAX ? INT8_MAX : value);
+	}
+	return true;
+}
+
+/**
+ * @brief Start from a phase histogram saved by getPhaseState(), as a hypothesis that the signal has to confirm.
+ * The bins are scaled down, so that a wrong phase is overruled within seconds.  Not meant for the ISR : it recalculates all bins.
+ * @param bins BIN_COUNT values, starting at the bin where the pulse starts
+ * @param millisSinceSecondStart time since the start of the current second, e.g. predicted from a clock that kept running
+ */
+template <uint16_t SAMPLE_FREQ, uint8_t BIN_COUNT, class InputPolicy>
+void BasicPhaseDetector<SAMPLE_FREQ, BIN_COUNT, InputPolicy>::presetPhase(const int8_t *bins, const uint16_t millisSinceSecondStart)
+{
+	//Inverse of getMillisSinceSecondStart() : the bins since the pulse start
+	const int32_t age = ((int32_t)millisSinceSecondStart * SAMPLE_FREQ / 1000 - _sampleCtr) / SAMPLES_PER_BIN - 1 - (int32_t)pendingBinCount();
+	const uint8_t pulseStartBin = ((_activeBin - age) % BIN_COUNT + BIN_COUNT) % BIN_COUNT;
+	for (uint8_t i = 0; i < BIN_COUNT; i++)
+	{
+		_bin.set(wrap(pulseStartBin + i), bins[i] >> PRESET_SHIFT);
+	}
+	recalculateCorrelation();
+	_pulseStartBin = pulseStartBin;
+	_subBinPhase = 0;
+	_subBinSamples = 0;
+	_samplerState = 0;
+}
+
+/**
+ * @brief Low power : the bin with the highest correlation within GUARD_BINS of the pulse start.  On equal correlation, the first bin wins.
+ * @returns INVALID when the highest correlation is on the edge of the window, as the real peak may be outside.
+ */
+template <uint16_t SAMPLE_FREQ, uint8_t BIN_COUNT, class InputPolicy>
+uint8_t BasicPhaseDetector<SAMPLE_FREQ, BIN_COUNT, InputPolicy>::windowPeak()
+{
+	const uint8_t firstBin = wrap(BIN_COUNT + _pulseStartBin - GUARD_BINS);
+	uint8_t peakBin = firstBin;
+	for (uint8_t i = 1; i <= 2 * GUARD_BINS; i++)
+	{
+		const uint8_t bin = wrap(firstBin + i);
+		if (_phaseCorrelation[bin] > _phaseCorrelation[peakBin])
+		{
+			peakBin = bin;
+		}
+	}
+	return peakBin == firstBin || peakBin == wrap(firstBin + 2 * GUARD_BINS) ? INVALID : peakBin;
+}
+
+/**
+ * @brief Called by ISR.
+ * _pulseActiveHigh allows you to invert the polarity of the pulse if your hardware uses active HIGH pulses.
+ * In low power, the pins aren't read outside the window around the pulse.  These bins are queued without a vote.
+ */
+template <uint16_t SAMPLE_FREQ, uint8_t BIN_COUNT, class InputPolicy>
+void BasicPhaseDetector<SAMPLE_FREQ, BIN_COUNT, InputPolicy>::process_one_sample()
+{
+	if (!_sampleCtr)
+	{
+		_skipBin = _lowPower && !inLowPowerWindow(_sampledBin);
+	}
+	for (uint8_t i = 0; i < _receiverCount && !_skipBin; i++)
+	{
+		const uint8_t sampled_data = _inputs[i].read();
+		_average[i] += !_pulseActiveHigh ? (sampled_data ? 0 : 1) : sampled_data;
+	}
+	averager();
+}
+
+/**
+ * @brief Process a block of pin samples at once, e.g. from a DMA buffer that's filled by a timer, or from a file.
+ * This is the same as calling process_one_sample() for each sample, but the samples of a bin are counted in one go.
+ * Blocks don't need to be aligned to bins, an incomplete bin is continued by the next call.
+ * @param packedBits pin samples taken every ms, 32 per word.  The oldest sample is the LSb of the first word.
+ * @param nSamples number of samples in the block
+ */
+template <uint16_t SAMPLE_FREQ, uint8_t BIN_COUNT, class InputPolicy>
+void BasicPhaseDetector<SAMPLE_FREQ, BIN_COUNT, InputPolicy>::process_samples(const uint32_t *packedBits, const size_t nSamples)
+{
+	process_samples(&packedBits, nSamples);
+}
+
+/**
+ * @brief Same as above, but for antenna diversity : a block of samples for each receiver.
+ * @param packedStreams for each receiver, a block of nSamples pin samples
+ */
+template <uint16_t SAMPLE_FREQ, uint8_t BIN_COUNT, class InputPolicy>
+void BasicPhaseDetector<SAMPLE_FREQ, BIN_COUNT, InputPolicy>::process_samples(const uint32_t *const *packedStreams, const size_t nSamples)
+{
+	constexpr uint32_t BIN_MASK = (1UL << SAMPLES_PER_BIN) - 1;
+	size_t pos = 0;
+	//Complete the bin that a previous call has started, then handle complete bins and keep the remaining samples for the next call
+	while (pos < nSamples)
+	{
+		if (_sampleCtr || pos + SAMPLES_PER_BIN > nSamples)
+		{
+			for (uint8_t i = 0; i < _receiverCount; i++)
+			{
+				const uint8_t sampled_data = (packedStreams[i][pos >> 5] >> (pos & 31)) & 1;
+				_average[i] += _pulseActiveHigh ? sampled_data : !sampled_data;
+			}
+			averager();
+			pos++;
+			continue;
+		}
+		for (uint8_t i = 0; i < _receiverCount; i++)
+		{
+			//Get the samples of the bin, these may be spread over two words
+			const uint8_t shift = pos & 31;
+			uint32_t slice = packedStreams[i][pos >> 5] >> shift;
+			if (shift + SAMPLES_PER_BIN > 32)
+			{
+				slice |= packedStreams[i][(pos >> 5) + 1] << (32 - shift);
+			}
+			const uint8_t highCount = __builtin_popcount(slice & BIN_MASK);
+			_average[i] = _pulseActiveHigh ? highCount : SAMPLES_PER_BIN - highCount;
+		}
+		_sampleCtr = SAMPLES_PER_BIN - 1;
+		averager();
+		pos += SAMPLES_PER_BIN;
+	}
+}
+
+/**
+ * @brief Alternative for sampling : the edges of the signal, e.g. from the input capture of a hardware timer.  There are only
+ * a few edges per second, so there are far less interrupts than with sampling, and the timing isn't limited to the sample period.
+ * Only the first receiver is used.  To be called from the ISR.  Don't sample the pin at the same time.
+ * @param timestamp time of the edge in µs, e.g. micros() or the captured timer value.  It may wrap around.
+ * @param level pin level after the edge
+ * @returns false when the queue is full and the edge has been dropped.  Call process_edges() more often.
+ */
+template <uint16_t SAMPLE_FREQ, uint8_t BIN_COUNT, class InputPolicy>
+bool BasicPhaseDetector<SAMPLE_FREQ, BIN_COUNT, InputPolicy>::process_edge(const uint32_t timestamp, const bool level)
+{
+	return _pendingEdges.push({timestamp, level});
+}
+
+/**
+ * @brief Convert the queued edges to bins.  As there are no edges while the signal doesn't change, this also has to be called
+ * regularly from the main loop (at least every second), to complete the bins up to now.
+ * The bins get the same vote as when the signal would have been sampled : the pulse must be active for more than 70% of the bin.
+ * @param now current time in µs, on the same clock as the timestamps of the edges
+ */
+template <uint16_t SAMPLE_FREQ, uint8_t BIN_COUNT, class InputPolicy>
+void BasicPhaseDetector<SAMPLE_FREQ, BIN_COUNT, InputPolicy>::process_edges(const uint32_t now)
+{
+	EDGE edge;
+	while (_pendingEdges.pop(edge))
+	{
+		edgeBinning(edge.timestamp);
+		_edgeActive = _pulseActiveHigh ? edge.level : !edge.level;
+	}
+	//An edge may have been captured after now was read
+	if ((int32_t)(now - _edgeTime) > 0)
+	{
+		edgeBinning(now);
+	}
+}
+
+/**
+ * @brief Add the time from the previous edge up to timestamp to the bins.  Each completed bin is queued for the deferred stage.
+ * To avoid rounding, time is scaled by BIN_COUNT, so that a bin takes exactly EDGE_CLOCK.
+ */
+template <uint16_t SAMPLE_FREQ, uint8_t BIN_COUNT, class InputPolicy>
+void BasicPhaseDetector<SAMPLE_FREQ, BIN_COUNT, InputPolicy>::edgeBinning(const uint32_t timestamp)
+{
+	if (!_edgesStarted)
+	{
+		_edgeTime = timestamp;
+		_edgesStarted = true;
+		return;
+	}
+	uint32_t elapsed = timestamp - _edgeTime;
+	_edgeTime = timestamp;
+	while (elapsed)
+	{
+		const uint32_t step = elapsed < MAX_EDGE_STEP ? elapsed : MAX_EDGE_STEP;
+		elapsed -= step;
+		uint32_t scaledStep = step * BIN_COUNT;
+		while (scaledStep)
+		{
+			const uint32_t binPart = EDGE_CLOCK - _edgeBinPos < scaledStep ? EDGE_CLOCK - _edgeBinPos : scaledStep;
+			_edgeActiveTime += _edgeActive ? binPart : 0;
+			_edgeBinPos += binPart;
+			scaledStep -= binPart;
+			if (_edgeBinPos == EDGE_CLOCK)
+			{
+				const FUZZY input = _edgeActiveTime * 10ULL < 3ULL * EDGE_CLOCK ? LOWV : (_edgeActiveTime * 10ULL > 7ULL * EDGE_CLOCK ? HIGHV : DONTKNOW);
+				measurePhase(_edgeActiveTime, EDGE_CLOCK);
+				queueVote(_weights[0] * input);
+				_edgeBinPos = _edgeActiveTime = 0;
+			}
+		}
+	}
+}
+
+#ifndef ROBUSTDCF_SAMPLE_FREQ
+#define ROBUSTDCF_SAMPLE_FREQ 1000
+#endif
+#ifndef ROBUSTDCF_BIN_COUNT
+#define ROBUSTDCF_BIN_COUNT 100
+#endif
+#ifndef ROBUSTDCF_INPUT_POLICY
+#define ROBUSTDCF_INPUT_POLICY DigitalReadInput
+#endif
+//The phase detector used by RobustDcf.  Its configuration can be changed using build flags.
+typedef BasicPhaseDetector<ROBUSTDCF_SAMPLE_FREQ, ROBUSTDCF_BIN_COUNT, ROBUSTDCF_INPUT_POLICY> PhaseDetector;
@@ -0,0 +1,88 @@
+/*
+ * This file is part of RobustDcf.
+ * 
+ * RobustDcf is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Foobar is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Foobar.  If not, see <https://www.gnu.org/licenses/>.
+ * 
+ * Copyright Christoph Tack, 2018
+*/
+/* Lock-free ring buffer for a single producer (e.g. an ISR) and a single consumer (e.g. the main loop).
+ * The producer only writes _head and the consumer only writes _tail, so no locking is needed.
+ * SIZE must be a power of two.  One entry is kept free to distinguish a full buffer from an empty one.
+ */
+#pragma once
+#include "platform.h"
+
+template <typename T, uint8_t SIZE>
+class RingBuffer
+{
+	static_assert(SIZE && !(SIZE & (SIZE - 1)), "SIZE must be a power of two");
+
+public:
+	/**
+	 * @brief Add an item to the buffer.  To be called by the producer only.
+	 * @returns false when the buffer is full, the item is then dropped.
+	 */
+	bool push(const T &item)
+	{
+		const uint8_t head = _head;
+		const uint8_t next = (head + 1) & (SIZE - 1);
+		if (next == _tail)
+		{
+			return false;
+		}
+		_items[head] = item;
+		__atomic_signal_fence(__ATOMIC_RELEASE); //item must be written before it's published
+		_head = next;
+		return true;
+	}
+
+	/**
+	 * @brief Take the oldest item from the buffer.  To be called by the consumer only.
+	 * @returns false when the buffer is empty.
+	 */
+	bool pop(T &item)
+	{
+		const uint8_t tail = _tail;
+		if (tail == _head)
+		{
+			return false;
+		}
+		__atomic_signal_fence(__ATOMIC_ACQUIRE);
+		item = _items[tail];
+		__atomic_signal_fence(__ATOMIC_RELEASE); //item must be read before its slot is released
+		_tail = (tail + 1) & (SIZE - 1);
+		return true;
+	}
+
+	/**
+	 * @brief Number of items in the buffer.  As the other side may be adding or taking items, it's a snapshot.
+	 */
+	uint8_t size() const
+	{
+		return (_head - _tail) & (SIZE - 1);
+	}
+
+	/**
+	 * @brief Drop all items in the buffer.  To be called by the consumer only.
+	 */
+	void clear()
+	{
+		_tail = _head;
+	}
+
+private:
+	T _items[SIZE];
+	volatile uint8_t _head = 0;
+	volatile uint8_t _tail = 0;
+};
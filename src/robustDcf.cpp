@@ -18,103 +18,850 @@
 */
 #include "robustDcf.h"
 
-static volatile bool secondTicked = false;
-static bool syncMark;
-static SECONDS_DATA clockPulseLength;
+RobustDcf::RobustDcf(const byte inputPin, bool pulseHighPolarity) : _pd(inputPin, pulseHighPolarity)
+{
+}
 
-RobustDcf::RobustDcf(const byte inputPin, bool pulseHighPolarity) : _pd(inputPin, pulseHighPolarity),
-                                                                   _minutes(21, 7, true, 0, 59),
-                                                                   _hours(29, 6, true, 0, 23),
-                                                                   _days(36, 6, false, 1, 31),
-                                                                   _months(45, 5, false, 1, 12),
-                                                                   _years(50, 8, false, 0, 99)
+/**
+ * @brief Antenna diversity : decode the combined signal of multiple receivers.  See PhaseDetector for the meaning of the parameters.
+ */
+RobustDcf::RobustDcf(const byte *inputPins, const uint8_t *weights, const uint8_t receiverCount, bool pulseHighPolarity) : _pd(inputPins, weights, receiverCount, pulseHighPolarity)
 {
 }
 
-//secondsTick is called by an ISR.  It should be kept as short as possible
-static void secondsTick(const bool isSyncMark, const SECONDS_DATA pulseLength)
+//secondsTick is called by the deferred stage of the phase detector, from within update().  The context is the decoder.
+void RobustDcf::secondsTick(void *context, const bool isSyncMark, const SECONDS_DATA pulseLength, const SOFT_PULSE soft)
 {
-    syncMark = isSyncMark;
-    clockPulseLength = pulseLength;
-    secondTicked = true;
+    RobustDcf *rd = (RobustDcf *)context;
+    rd->_syncMark = isSyncMark;
+    rd->_clockPulseLength = pulseLength;
+    rd->_softPulse = soft;
+    rd->_secondTicked = true;
 }
 
 void RobustDcf::init()
 {
-    _pd.init(secondsTick);
+    setPhaseLocked(false, millis());
+    _pd.init(secondsTick, this);
     _sd.clear();
-    _minutes.clear();
-    _hours.clear();
-    _days.clear();
-    _months.clear();
-    _years.clear();
+    _epoch.clear();
     _tzd.clear();
-    _watchDog.start(10000, AsyncDelay::MILLIS);
+    _secondEpochValid = false;
+    _holdover = false;
+    _badSeconds = 0;
+    _previousSyncMark = false;
+    _restoredMinuteValid = false;
+    _lastTick = _initTime = millis();
+    _stats.phaseLockTime = _stats.minuteLockTime = 0;
+}
+
+/**
+ * @brief Alternative for the SysTick sampling : feed a block of pin samples to the decoder.  See PhaseDetector::process_samples().
+ * Call update() at least every second, so that no samples get lost.
+ */
+void RobustDcf::process_samples(const uint32_t *packedBits, const size_t nSamples)
+{
+    _pd.process_samples(packedBits, nSamples);
+}
+
+/**
+ * @brief Same as above, with a block of samples for each receiver.
+ */
+void RobustDcf::process_samples(const uint32_t *const *packedStreams, const size_t nSamples)
+{
+    _pd.process_samples(packedStreams, nSamples);
+}
+
+/**
+ * @brief Alternative for the SysTick sampling : feed an edge of the signal to the decoder, e.g. from a pin change or input capture
+ * interrupt.  See PhaseDetector::process_edge().
+ */
+bool RobustDcf::process_edge(const uint32_t timestamp, const bool level)
+{
+    return _pd.process_edge(timestamp, level);
+}
+
+/**
+ * @brief Bin the edges that have been fed by process_edge().  Call this from the main loop, right before update().
+ * @param now current time in µs, e.g. micros()
+ */
+void RobustDcf::process_edges(const uint32_t now)
+{
+    _pd.process_edges(now);
+}
+
+/**
+ * @brief Low power mode for battery powered clocks : once locked, only the part of each second around the pulse is sampled and
+ * decoded.  See PhaseDetector::setLowPower().  The setting is kept by init().
+ */
+void RobustDcf::setLowPower(const bool enable)
+{
+    _pd.setLowPower(enable);
 }
 
 //Becomes true once a minute (on second 59) to let you know that unixEpoch has been updated.
+//This is the deferred stage of the decoder : it processes all bins that have been sampled since the previous call.
+//When a minute is decoded, it returns immediately, the remaining bins are processed by the next call.
 bool RobustDcf::update(Chronos::EpochTime &unixEpoch)
 {
-    if (!secondTicked)
+    while (nextSecond())
+    {
+        if (_minuteDecoded)
+        {
+            unixEpoch = _secondEpoch + 1;
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief Same as above, but becomes true every second, once the first minute has been decoded.
+ * When it returns true, the remaining bins are processed by the next call.
+ * While the signal is lost, the seconds are kept by millis(), until the estimated error becomes too large.
+ * @param time the current UTC time, with the milliseconds that have passed since the start of the second.
+ */
+bool RobustDcf::update(UTC_TIME &time)
+{
+    while (nextSecond())
+    {
+        if (_newSecond)
+        {
+            const uint32_t micros = _pd.getMicrosSinceSecondStart();
+            time.latency = micros / 1000;
+            time.unixEpoch = _secondEpoch + time.latency / 1000;
+            time.milliseconds = time.latency % 1000;
+            time.microseconds = micros % 1000;
+            time.error = holdoverError(_secondMillis);
+            time.holdover = false;
+            return true;
+        }
+    }
+    return holdoverSecond(time);
+}
+
+/**
+ * @brief Event driven alternative for update() : register a handler for one or more events.  It's called by dispatchEvents().
+ * Subscribe before process() runs, the subscriptions aren't protected against concurrent use.
+ * @param eventTypes EVENT_TYPE values, or'ed together
+ * @returns false when all ROBUSTDCF_MAX_SUBSCRIBERS places are taken
+ */
+bool RobustDcf::subscribe(const uint8_t eventTypes, eventHandler handler)
+{
+    for (SUBSCRIPTION &subscription : _subscriptions)
+    {
+        if (!subscription.handler)
+        {
+            subscription = {eventTypes, handler};
+            _eventTypes |= eventTypes;
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief Remove all subscriptions of a handler.
+ */
+void RobustDcf::unsubscribe(eventHandler handler)
+{
+    _eventTypes = 0;
+    for (SUBSCRIPTION &subscription : _subscriptions)
+    {
+        if (subscription.handler == handler)
+        {
+            subscription = {0, nullptr};
+        }
+        _eventTypes |= subscription.eventTypes;
+    }
+}
+
+/**
+ * @brief Deferred stage for the event driven use : process all pending bins and queue the events for the subscribed handlers,
+ * including the seconds that are counted by millis() during holdover.  Unlike update(), it doesn't stop at a decoded minute.
+ * @returns true when there are events waiting for dispatchEvents()
+ */
+bool RobustDcf::process()
+{
+    while (nextSecond())
+    {
+    }
+    UTC_TIME time;
+    if (holdoverSecond(time))
+    {
+        queueEvent(SECOND_TICK, millis() - time.milliseconds);
+    }
+    return _events.size();
+}
+
+/**
+ * @brief Call the handlers of the queued events, oldest event first.  process() and dispatchEvents() are the producer and
+ * consumer of a lock-free queue, so the events can be dispatched from another context than the one that processes the bins,
+ * e.g. a low priority interrupt that's triggered when process() returns true.
+ * @returns the number of events that have been dispatched
+ */
+uint8_t RobustDcf::dispatchEvents()
+{
+    uint8_t count = 0;
+    EVENT event;
+    while (_events.pop(event))
+    {
+        for (const SUBSCRIPTION &subscription : _subscriptions)
+        {
+            if (subscription.handler && (subscription.eventTypes & event.type))
+            {
+                subscription.handler(event);
+            }
+        }
+        count++;
+    }
+    return count;
+}
+
+/**
+ * @brief Queue an event, when there's a handler for it.  The time of the event is counted from the last fix.
+ * @param ms millis() at the start of the second of the event
+ */
+void RobustDcf::queueEvent(const EVENT_TYPE type, const uint32_t ms)
+{
+    if (!(_eventTypes & type))
+    {
+        return;
+    }
+    EVENT event;
+    event.type = type;
+    event.millis = ms;
+    event.timeValid = _secondEpochValid;
+    event.unixEpoch = _lastFixEpoch + (sinceFix(ms) + 500) / 1000;
+    event.holdover = _holdover;
+    event.error = holdoverError(ms);
+    event.frame = _frame;
+    if (!_events.push(event))
+    {
+        _stats.droppedEvents++;
+    }
+}
+
+/**
+ * @brief Queue PHASE_LOCKED or PHASE_LOST when the lock changes.
+ * @param ms millis() at the start of the second in which it changed
+ */
+void RobustDcf::setPhaseLocked(const bool locked, const uint32_t ms)
+{
+    if (locked != _phaseLocked)
+    {
+        _phaseLocked = locked;
+        queueEvent(locked ? PHASE_LOCKED : PHASE_LOST, ms);
+    }
+}
+
+/**
+ * @brief Holdover : count the seconds by millis(), corrected for its drift, while there are no usable second ticks.
+ * @returns true when a new second has started
+ */
+bool RobustDcf::holdoverSecond(UTC_TIME &time)
+{
+    const uint32_t now = millis();
+    if (!_secondEpochValid)
     {
         return false;
     }
-    secondTicked = false;
-    if(_watchDog.isExpired())
+    if (!_holdover)
+    {
+        if (now - _lastTick < HOLDOVER_DELAY)
+        {
+            return false;
+        }
+        enterHoldover();
+    }
+    time.error = holdoverError(now);
+    if (time.error > MAX_HOLDOVER_ERROR)
     {
-        _watchDog.restart();
-        init();
+        //Lost track of the time, wait for a new fix
+        _secondEpochValid = false;
         return false;
     }
-    _watchDog.restart();
-    _sd.updateSeconds(syncMark, clockPulseLength);
-    uint8_t second;
-    SecondsDecoder::BITDATA data;
-    if ((!_sd.getSecond(second)) || (second != 59) || (!_sd.getTimeData(&data)))
+    const uint32_t elapsed = sinceFix(now);
+    const Chronos::EpochTime epoch = _lastFixEpoch + elapsed / 1000;
+    if (epoch == _secondEpoch)
     {
         return false;
     }
-    return updateClock(&data, &unixEpoch);
+    _secondEpoch = epoch;
+    time.unixEpoch = epoch;
+    time.milliseconds = time.latency = elapsed % 1000;
+    time.microseconds = 0;
+    time.holdover = true;
+    return true;
 }
 
-bool RobustDcf::updateClock(SecondsDecoder::BITDATA *pdata, Chronos::EpochTime *pEpoch)
+/**
+ * @brief The signal is lost : the time is kept by millis() until the second ticks match the predicted time again.
+ * The bits that have been received are dropped, so that they don't block the prediction once the signal is back.
+ */
+void RobustDcf::enterHoldover()
 {
-    bool bSuccess = true;
-    bSuccess &= _minutes.update(pdata);
-    bSuccess &= _hours.update(pdata);
-    bSuccess &= _days.update(pdata);
-    bSuccess &= _months.update(pdata);
-    bSuccess &= _years.update(pdata);
-    bSuccess &= BcdDecoder::dmyParityEven(pdata);
-    bSuccess &= _tzd.update(pdata);
+    _sd.clear();
+    if (!_holdover)
+    {
+        _holdover = true;
+        _stats.holdovers++;
+    }
+}
 
-    if (!bSuccess)
+/**
+ * @brief Process the pending bins up to the next second tick.
+ * The seconds are counted from the last fix : the last decoded minute or the predicted time.
+ * @returns true when a second has ticked, false when there are no more pending bins or when the watchdog restarted the decoder.
+ */
+bool RobustDcf::nextSecond()
+{
+    while (_pd.process_one_bin())
+    {
+        if (!_secondTicked)
+        {
+            continue;
+        }
+        _secondTicked = false;
+        uint32_t now = millis();
+        if (now - _lastTick >= WATCHDOG_TIMEOUT)
+        {
+            if (!_secondEpochValid || holdoverError(now) > MAX_HOLDOVER_ERROR)
+            {
+                _stats.watchdogResets++;
+                init();
+                return false;
+            }
+            enterHoldover();
+        }
+        _lastTick = now;
+        //Seconds without a pulse in a row, or with unclear pulses : the signal is lost, although the phase may still be locked.
+        const bool badSecond = _clockPulseLength == UNKNOWNPULSE || (_syncMark && _previousSyncMark);
+        _previousSyncMark = _syncMark;
+        _badSeconds = badSecond ? (_badSeconds < UINT8_MAX ? _badSeconds + 1 : _badSeconds) : 0;
+        if (_badSeconds >= LOST_SIGNAL_SECONDS && _secondEpochValid)
+        {
+            enterHoldover();
+        }
+        if (_holdover && badSecond)
+        {
+            _sd.clear();
+        }
+        else
+        {
+            _sd.updateSeconds(_clockPulseLength, _softPulse);
+        }
+        _stats.seconds++;
+        _stats.unknownPulses += _clockPulseLength == UNKNOWNPULSE;
+        _stats.phaseLockTime = _stats.phaseLockTime ? _stats.phaseLockTime : now - _initTime;
+        uint8_t second;
+        SecondsDecoder::BITDATA data;
+        Chronos::EpochTime unixEpoch;
+        //millis() at the start of the second, so that the time it took to get here doesn't matter
+        const uint32_t secondStart = now - _pd.getMillisSinceSecondStart();
+        if (!badSecond || _badSeconds >= LOST_SIGNAL_SECONDS)
+        {
+            setPhaseLocked(!badSecond, secondStart);
+        }
+        const bool minuteSynced = _sd.getSecond(second);
+        if (minuteSynced && !_stats.minuteLockTime)
+        {
+            _stats.minuteLockTime = now - _initTime;
+        }
+        const bool minuteComplete = minuteSynced && (second == 59) && _sd.getTimeData(&data);
+        _minuteDecoded = minuteComplete && updateClock(&data, &unixEpoch) && plausible(unixEpoch - 1, secondStart);
+        if (minuteComplete && !_minuteDecoded && matchFrame(&data, secondStart, unixEpoch))
+        {
+            _minuteDecoded = true;
+            _stats.correctedMinutes++;
+        }
+        _stats.minutes += minuteSynced && (second == 59);
+        if (_minuteDecoded)
+        {
+            _stats.decodedMinutes++;
+            //The decoded time is that of the start of the next minute
+            Chronos::EpochTime predicted;
+            _fixConfirmed = predictEpoch(secondStart, predicted) && predicted == unixEpoch - 1;
+            updateDrift(unixEpoch - 1, secondStart);
+            setFix(unixEpoch - 1, secondStart);
+            _holdover = false;
+            queueEvent(MINUTE_DECODED, secondStart + 1000);
+            const bool announced = TimeZoneDecoder::isChangeAnnounced(&data);
+            if (announced && !_changeAnnounced)
+            {
+                queueEvent(TIMEZONE_CHANGE_ANNOUNCED, secondStart + 1000);
+            }
+            _changeAnnounced = announced;
+        }
+        else if ((!_secondEpochValid || _holdover) && predictSecond(secondStart))
+        {
+            _holdover = false;
+        }
+        if (_holdover)
+        {
+            //The time stamps come from holdoverSecond()
+            _newSecond = false;
+            return true;
+        }
+        //The seconds are counted from the last fix, so that ticks that are missing or too many (e.g. while the phase lock is
+        //being regained) don't make the time stamps slip.
+        const Chronos::EpochTime epoch = _lastFixEpoch + (sinceFix(secondStart) + 500) / 1000;
+        _newSecond = _secondEpochValid && epoch != _secondEpoch;
+        _secondEpoch = epoch;
+        _secondMillis = secondStart;
+        if (_newSecond)
+        {
+            queueEvent(SECOND_TICK, secondStart);
+        }
+        return true;
+    }
+    if (millis() - _lastTick >= HOLDOVER_DELAY)
+    {
+        //The second ticks have stopped
+        setPhaseLocked(false, _lastTick);
+    }
+    return false;
+}
+
+/**
+ * @brief Fast fix after the signal has been lost : the time is predicted from the last fix and millis().  The prediction is
+ * accepted as soon as the second tick starts within the error of the predicted phase, and the bits received since the phase
+ * lock match the bits that should have been transmitted.  So there's no need to wait for the minute sync and a complete minute.
+ * @param secondStart millis() at the start of the current second
+ * @returns true when the predicted time has been accepted
+ */
+bool RobustDcf::predictSecond(uint32_t secondStart)
+{
+    const uint16_t error = holdoverError(secondStart);
+    if (!_lastFixValid || error > MAX_HOLDOVER_ERROR)
     {
         return false;
     }
-    if (!getUnixEpochTime(pEpoch))
+    const uint32_t elapsed = sinceFix(secondStart);
+    const uint16_t phase = elapsed % 1000;
+    if ((phase < 500 ? phase : 1000 - phase) > error + TICK_ERROR)
     {
         return false;
     }
-    TimeChangeRule myDST = {"CEST", Last, Sun, Mar, 2, +120}; //Last Sunday of March, at 2AM, go to UTC+120min
-    TimeChangeRule mySTD = {"CET", Last, Sun, Oct, 3, +60};   //Last Sunday of October, at 3AM, go to UTC+60min
-    Timezone myTZ(myDST, mySTD);
-    Chronos::DateTime localTime = myTZ.toLocal(*pEpoch);
+    const Chronos::EpochTime epoch = _lastFixEpoch + (elapsed + 500) / 1000;
+    const uint8_t second = epoch % SecondsDecoder::SECONDS_PER_MINUTE;
+    const Chronos::EpochTime minuteStart = epoch - second;
+    //The frame transmitted during a minute holds the time at the end of that minute
+    const uint64_t currentFrame = predictFrame(minuteStart + 60);
+    const uint64_t previousFrame = predictFrame(minuteStart);
+    //Align the frames with the bit shifter of the SecondsDecoder, where the bit of the current second is bit 59.
+    const uint64_t window = (1ULL << SecondsDecoder::SECONDS_PER_MINUTE) - 1;
+    const uint64_t expected = ((currentFrame << (59 - second)) | (previousFrame >> (second + 1))) & window;
+    SecondsDecoder::BITDATA recent;
+    _sd.getRecentBits(&recent);
+    const uint8_t receivedBits = min(recent.validBitCtr, SecondsDecoder::SECONDS_PER_MINUTE);
+    uint64_t compared = ((FrameDecoder::PREDICTABLE_BITS << (59 - second)) | (FrameDecoder::PREDICTABLE_BITS >> (second + 1))) & window;
+    compared &= ~((1ULL << (SecondsDecoder::SECONDS_PER_MINUTE - receivedBits)) - 1);
+    compared &= ~recent.weakBits;
+    if (__builtin_popcountll(compared) < MIN_PREDICTED_BITS || ((recent.bitShifter ^ expected) & compared))
+    {
+        return false;
+    }
+    setFix(epoch, secondStart);
+    uint8_t decodedSecond;
+    if (!_sd.getSecond(decodedSecond))
+    {
+        if (_restoredMinuteValid)
+        {
+            _sd.presetMinute(_restoredMinute, second);
+        }
+        else
+        {
+            _sd.presetSecond(second);
+        }
+    }
+    _restoredMinuteValid = false;
+    return true;
+}
 
+/**
+ * @brief Remember the time of a second.  The time stamps of the following seconds are derived from it.
+ * @param unixEpoch UTC time of the second
+ * @param secondStart millis() at the start of the second
+ */
+void RobustDcf::setFix(Chronos::EpochTime unixEpoch, uint32_t secondStart)
+{
+    _lastFixEpoch = unixEpoch;
+    _lastFixMillis = secondStart;
+    _lastFixValid = true;
+    _secondEpochValid = true;
+}
+
+/**
+ * @brief Measure how fast millis() runs, between decoded minutes that are at least DRIFT_INTERVAL apart.
+ * The measurements are averaged, to reduce the error of the second ticks.
+ * @param unixEpoch UTC time of the decoded second
+ * @param secondStart millis() at the start of that second
+ */
+void RobustDcf::updateDrift(Chronos::EpochTime unixEpoch, uint32_t secondStart)
+{
+    if (_driftAnchorValid && unixEpoch > _driftAnchorEpoch && unixEpoch - _driftAnchorEpoch < 86400)
+    {
+        const uint32_t span = (unixEpoch - _driftAnchorEpoch) * 1000;
+        if (span < DRIFT_INTERVAL * 1000)
+        {
+            return;
+        }
+        const int32_t measured = (int64_t)(int32_t)(secondStart - _driftAnchorMillis - span) * 1000000000 / span;
+        if (measured > -MAX_DRIFT && measured < MAX_DRIFT)
+        {
+            _drift = _driftValid ? (3 * _drift + measured) / 4 : measured;
+            _driftValid = true;
+        }
+    }
+    _driftAnchorEpoch = unixEpoch;
+    _driftAnchorMillis = secondStart;
+    _driftAnchorValid = true;
+}
+
+/**
+ * @brief Time since the last fix, corrected for the drift of millis().
+ * @param ms millis() value
+ */
+uint32_t RobustDcf::sinceFix(uint32_t ms)
+{
+    const uint32_t elapsed = ms - _lastFixMillis;
+    return elapsed - (int32_t)((int64_t)elapsed * _drift / 1000000000);
+}
+
+/**
+ * @brief Estimated error of the time at the given millis() value, when it is derived from the last fix.
+ * Values before the fix count as the fix itself.
+ */
+uint16_t RobustDcf::holdoverError(uint32_t ms)
+{
+    const uint32_t uncertainty = _driftValid ? DRIFT_UNCERTAINTY : UNKNOWN_DRIFT_UNCERTAINTY;
+    const int32_t elapsed = ms - _lastFixMillis;
+    const uint64_t error = TICK_ERROR + (uint64_t)(elapsed > 0 ? elapsed : 0) * uncertainty / 1000000000;
+    return error < UINT16_MAX ? error : UINT16_MAX;
+}
+
+/**
+ * @brief The minute frame for the given time.  The summer time follows the German rules, as long as the UTC offset of the last
+ * fix does.  Otherwise the UTC offset of the last fix is used.
+ */
+uint64_t RobustDcf::predictFrame(Chronos::EpochTime unixEpoch)
+{
+    const int16_t utcOffset = germanUtcOffset(_lastFixEpoch) == _utcOffset ? germanUtcOffset(unixEpoch) : _utcOffset;
+    const Chronos::EpochTime localTime = unixEpoch + utcOffset;
+    const int32_t days = localTime / 86400;
+    const uint32_t secondOfDay = localTime % 86400;
+    FrameDecoder::FRAME frame;
+    EpochCalculator::civilFromDays(days, frame.year, frame.month, frame.day);
+    frame.weekday = (days + 3) % 7 + 1; //1970-01-01 was a thursday
+    frame.hour = secondOfDay / 3600;
+    frame.minute = secondOfDay / 60 % 60;
+    frame.isSummerTime = utcOffset == 7200; //CEST is UTC+2
+    frame.isWinterTime = !frame.isSummerTime;
+    frame.timeZoneChangeAnnounced = false;
+    return FrameDecoder::encode(frame);
+}
+
+/**
+ * @brief The time of a second, counted from the last fix.
+ * @param secondStart millis() at the start of the second
+ * @returns false when there's no fix or when the error has become too large
+ */
+bool RobustDcf::predictEpoch(uint32_t secondStart, Chronos::EpochTime &unixEpoch)
+{
+    unixEpoch = _lastFixEpoch + (sinceFix(secondStart) + 500) / 1000;
+    return _lastFixValid && holdoverError(secondStart) <= MAX_HOLDOVER_ERROR;
+}
+
+/**
+ * @brief A decoded minute that contradicts the predicted time, while that time has been confirmed by a previous minute, is more
+ * likely to be a decoding error (e.g. two bits of a parity group flipped) than a jump of the time.  It's only accepted once a
+ * second decoded minute agrees with it.  In the meantime, matchFrame() may still accept the minute as the predicted one.
+ * @param unixEpoch decoded time of the last second of the minute
+ * @param secondStart millis() at the start of that second
+ */
+bool RobustDcf::plausible(Chronos::EpochTime unixEpoch, uint32_t secondStart)
+{
+    Chronos::EpochTime predicted;
+    if (!_fixConfirmed || !predictEpoch(secondStart, predicted) || predicted == unixEpoch)
+    {
+        _contradictionValid = false;
+        return true;
+    }
+    const bool repeated = _contradictionValid && _contradictionEpoch + (secondStart - _contradictionMillis + 500) / 1000 == unixEpoch;
+    _contradictionEpoch = unixEpoch;
+    _contradictionMillis = secondStart;
+    _contradictionValid = true;
+    _stats.rejectedMinutes += !repeated;
+    return repeated;
+}
+
+/**
+ * @brief UTC offset in seconds of the German time : CEST (UTC+2) from the last sunday of March, 1:00 UTC, up to the last sunday of
+ * October, 1:00 UTC.  CET (UTC+1) otherwise.
+ */
+int16_t RobustDcf::germanUtcOffset(Chronos::EpochTime unixEpoch)
+{
+    const int32_t days = unixEpoch / 86400;
+    uint8_t year, month, day;
+    EpochCalculator::civilFromDays(days, year, month, day);
+    //The last sunday of the month : 1970-01-01 was a thursday, (days + 3) % 7 is 6 on sundays.
+    const int32_t lastDayOfMarch = EpochCalculator::daysSinceEpoch(year, 3, 31), lastDayOfOctober = EpochCalculator::daysSinceEpoch(year, 10, 31);
+    const Chronos::EpochTime summerStart = (lastDayOfMarch - (lastDayOfMarch + 4) % 7) * 86400L + 3600;
+    const Chronos::EpochTime summerEnd = (lastDayOfOctober - (lastDayOfOctober + 4) % 7) * 86400L + 3600;
+    return unixEpoch >= summerStart && unixEpoch < summerEnd ? 7200 : 3600;
+}
+
+/**
+ * @brief Maximum likelihood correction of a minute that failed the checks : it's compared with the frame of the predicted minute,
+ * and with those of the minutes around it when the error of the prediction is large.  The minute is accepted as the one that
+ * matches best, when that's within the error budget (ROBUSTDCF_MAX_FRAME_DISTANCE) and clearly better than the others.
+ * See FrameDecoder::distance().  The last fix must have been confirmed by a decoded minute, so that a decoding error doesn't
+ * spread to the next minutes.
+ * @param data the bits of the minute that has just been completed
+ * @param secondStart millis() at the start of its last second
+ * @param unixEpoch receives the UTC time at the end of the minute, like updateClock()
+ * @returns true when the minute has been matched
+ */
+bool RobustDcf::matchFrame(const SecondsDecoder::BITDATA *data, uint32_t secondStart, Chronos::EpochTime &unixEpoch)
+{
+    const uint16_t error = holdoverError(secondStart);
+    if (!ROBUSTDCF_MAX_FRAME_DISTANCE || !_fixConfirmed || data->validBitCtr < SecondsDecoder::SECONDS_PER_MINUTE - 1 || error > MAX_MATCH_ERROR)
+    {
+        return false;
+    }
+    //The minute of which the last second (59) is nearest to the predicted time, and the minutes around it that are within the error
+    const Chronos::EpochTime predicted = _lastFixEpoch + (sinceFix(secondStart) + 500) / 1000;
+    const Chronos::EpochTime predictedStart = (predicted + 31) / 60 * 60 - 60;
+    const int8_t candidates = (error + 30000) / 60000;
+    uint8_t best = UINT8_MAX, runnerUp = UINT8_MAX;
+    Chronos::EpochTime bestStart = 0;
+    for (int8_t k = -candidates; k <= candidates; k++)
+    {
+        const Chronos::EpochTime minuteStart = predictedStart + k * 60;
+        //The frame transmitted during a minute holds the time at the end of that minute
+        const uint8_t distance = FrameDecoder::distance(data, predictFrame(minuteStart + 60));
+        if (distance < best)
+        {
+            runnerUp = best;
+            best = distance;
+            bestStart = minuteStart;
+        }
+        else if (distance < runnerUp)
+        {
+            runnerUp = distance;
+        }
+    }
+    if (best > ROBUSTDCF_MAX_FRAME_DISTANCE || runnerUp < best + MIN_FRAME_MARGIN)
+    {
+        return false;
+    }
+    unixEpoch = bestStart + 60;
+    const SecondsDecoder::BITDATA bestFrame = {predictFrame(unixEpoch), SecondsDecoder::SECONDS_PER_MINUTE, 0};
+    FrameDecoder::decode(&bestFrame, _frame);
     return true;
 }
 
-//Currently only minute resolution.
-bool RobustDcf::getUnixEpochTime(Chronos::EpochTime *pUnixEpoch)
+/**
+ * @brief Snapshot of the counters and the signal quality.  The counters are cheap enough to be always on, the gauges
+ * (phase peak and margins) are only calculated here.
+ */
+void RobustDcf::getStatistics(STATISTICS &stats)
 {
-    uint8_t minute, hour, day, month, year;
-    int16_t secondsOffset;
-    if (_minutes.getTime(minute) && _hours.getTime(hour) && _days.getTime(day) && _months.getTime(month) && _years.getTime(year))
+    stats = _stats;
+    stats.phaseCorrections = _pd.getPhaseCorrections() - _phaseCorrectionsBase;
+    stats.droppedBins = _pd.getDroppedBins() - _droppedBinsBase;
+    stats.skippedBins = _pd.getSkippedBins() - _skippedBinsBase;
+    _pd.getPeak(stats.phasePeak, stats.phaseMargin);
+    stats.minuteMargin = _sd.getMinuteMargin();
+    stats.drift = _drift;
+}
+
+/**
+ * @brief Restart the counters.  The lock times are restarted by init().
+ */
+void RobustDcf::clearStatistics()
+{
+    const uint32_t phaseLockTime = _stats.phaseLockTime, minuteLockTime = _stats.minuteLockTime;
+    _stats = {};
+    _stats.phaseLockTime = phaseLockTime;
+    _stats.minuteLockTime = minuteLockTime;
+    _phaseCorrectionsBase = _pd.getPhaseCorrections();
+    _droppedBinsBase = _pd.getDroppedBins();
+    _skippedBinsBase = _pd.getSkippedBins();
+}
+
+//The saved state is little endian, whatever the platform
+template <typename T>
+static void putValue(uint8_t *&p, const T value)
+{
+    for (size_t i = 0; i < sizeof(T); i++)
+    {
+        *p++ = (uint64_t)value >> (i << 3);
+    }
+}
+
+template <typename T>
+static T getValue(const uint8_t *&p)
+{
+    uint64_t value = 0;
+    for (size_t i = 0; i < sizeof(T); i++)
+    {
+        value |= (uint64_t)*p++ << (i << 3);
+    }
+    return (T)value;
+}
+
+//Fletcher-16
+static uint16_t stateChecksum(const uint8_t *buffer, size_t size)
+{
+    uint16_t sum1 = 0, sum2 = 0;
+    while (size--)
+    {
+        sum1 = (sum1 + *buffer++) % 255;
+        sum2 = (sum2 + sum1) % 255;
+    }
+    return (sum2 << 8) | sum1;
+}
+
+/**
+ * @brief Snapshot of what the decoder has learned : the phase and minute histograms, the time zone, the last fix and the drift
+ * of millis().  Store it e.g. in EEPROM or RTC memory before powering down, so that restoreState() can pick up from there.
+ * @param buffer receives STATE_SIZE bytes, in a format that doesn't depend on the platform
+ * @returns the number of bytes written, 0 when the buffer is too small
+ */
+size_t RobustDcf::saveState(uint8_t *buffer, size_t size)
+{
+    if (size < STATE_SIZE)
+    {
+        return 0;
+    }
+    uint8_t *p = buffer;
+    *p++ = 'R';
+    *p++ = 'D';
+    *p++ = STATE_VERSION;
+    *p++ = ROBUSTDCF_BIN_COUNT;
+    uint8_t *flags = p++;
+    *flags = _driftValid ? STATE_DRIFT_VALID : 0;
+    *flags |= _lastFixValid ? STATE_FIX_VALID : 0;
+    putValue<int16_t>(p, _utcOffset);
+    putValue<int32_t>(p, _drift);
+    putValue<uint32_t>(p, _lastFixEpoch);
+    putValue<uint32_t>(p, _lastFixValid ? millis() - _lastFixMillis : 0);
+    putValue<int8_t>(p, _tzd.getSummerTimeVotes());
+    memset(p, 0, ROBUSTDCF_BIN_COUNT + SecondsDecoder::SECONDS_PER_MINUTE);
+    *flags |= _pd.getPhaseState((int8_t *)p) ? STATE_PHASE_LOCKED : 0;
+    p += ROBUSTDCF_BIN_COUNT;
+    *flags |= _sd.getMinuteState((int8_t *)p) ? STATE_MINUTE_SYNCED : 0;
+    p += SecondsDecoder::SECONDS_PER_MINUTE;
+    putValue<uint16_t>(p, stateChecksum(buffer, p - buffer));
+    return STATE_SIZE;
+}
+
+/**
+ * @brief Warm restart from a state saved by saveState() : restarts the decoder like init(), but with the time zone and the drift
+ * of millis() that were known.  When the time since saving is known, the saved time is held over and the phase and minute
+ * histograms come back as hypotheses.  The signal has to confirm these, as with a prediction after a signal loss.
+ * @param elapsed ms between saveState() and now, as measured by a clock that kept running, e.g. millis() across a soft reset.
+ * When unknown, the decoder starts from scratch, apart from the time zone and the drift.
+ * @returns false when the state is unusable : corrupt, or saved by a different version or configuration.  init() has not been called then.
+ */
+bool RobustDcf::restoreState(const uint8_t *buffer, size_t size, uint32_t elapsed)
+{
+    if (size < STATE_SIZE || buffer[0] != 'R' || buffer[1] != 'D' || buffer[2] != STATE_VERSION || buffer[3] != ROBUSTDCF_BIN_COUNT)
+    {
+        return false;
+    }
+    const uint8_t *p = buffer + STATE_SIZE - 2;
+    if (getValue<uint16_t>(p) != stateChecksum(buffer, STATE_SIZE - 2))
+    {
+        return false;
+    }
+    init();
+    //Only the saved time counts, not the one that this instance may still have
+    _lastFixValid = false;
+    _fixConfirmed = false;
+    _contradictionValid = false;
+    p = buffer + 4;
+    const uint8_t flags = *p++;
+    _utcOffset = getValue<int16_t>(p);
+    _drift = getValue<int32_t>(p);
+    _driftValid = flags & STATE_DRIFT_VALID;
+    _driftAnchorValid = false;
+    const Chronos::EpochTime fixEpoch = getValue<uint32_t>(p);
+    const uint32_t fixAge = getValue<uint32_t>(p);
+    _tzd.presetSummerTimeVotes(getValue<int8_t>(p));
+    const int8_t *phaseBins = (const int8_t *)p;
+    const int8_t *minuteBins = phaseBins + ROBUSTDCF_BIN_COUNT;
+    if (!(flags & STATE_FIX_VALID) || elapsed == UNKNOWN_ELAPSED)
     {
-        _tzd.getSecondsOffset(secondsOffset, hour, minute);
-        Chronos::DateTime localtime(tmYearToCalendar(y2kYearToTm(year)), month, day, hour, minute);
-        *pUnixEpoch = localtime.asEpoch() - secondsOffset;
         return true;
     }
-    return false;
+    const uint32_t now = millis();
+    _lastFixEpoch = fixEpoch;
+    _lastFixMillis = now - fixAge - elapsed;
+    _lastFixValid = true;
+    _fixConfirmed = false;
+    const uint16_t error = holdoverError(now);
+    if (error > MAX_HOLDOVER_ERROR)
+    {
+        return true;
+    }
+    //Hold over until the second ticks confirm the time
+    _secondEpochValid = true;
+    _holdover = true;
+    if ((flags & STATE_PHASE_LOCKED) && error <= MAX_PRESET_ERROR)
+    {
+        _pd.presetPhase(phaseBins, sinceFix(now) % 1000);
+    }
+    if (flags & STATE_MINUTE_SYNCED)
+    {
+        memcpy(_restoredMinute, minuteBins, SecondsDecoder::SECONDS_PER_MINUTE);
+        _restoredMinuteValid = true;
+    }
+    return true;
+}
+
+/**
+ * @brief The fields of the minute that is being received, as far as they are complete.  These hold the time at the end of the minute.
+ * @returns FrameDecoder::MINUTE_FIELDS, HOUR_FIELDS and DATE_FIELDS for the fields that are valid
+ */
+uint8_t RobustDcf::getPartialFrame(FrameDecoder::FRAME &frame)
+{
+    SecondsDecoder::BITDATA data;
+    if (!_sd.getPartialData(&data))
+    {
+        return 0;
+    }
+    FrameDecoder::repairWeakBits(&data);
+    return FrameDecoder::decodePartial(&data, frame);
+}
+
+bool RobustDcf::updateClock(SecondsDecoder::BITDATA *pdata, Chronos::EpochTime *pEpoch)
+{
+    _stats.repairedBits += FrameDecoder::repairWeakBits(pdata);
+    //The time zone votes must be updated, even when the frame isn't valid
+    bool bSuccess = _tzd.update(pdata);
+    FrameDecoder::FRAME frame;
+    const uint16_t errors = FrameDecoder::decodeErrors(pdata, frame);
+    if (errors)
+    {
+        for (uint8_t i = 0; i < FrameDecoder::PARITY_GROUP_COUNT; i++)
+        {
+            _stats.parityErrors[i] += (errors >> i) & 1;
+        }
+        for (uint8_t i = 0; i < FrameDecoder::FIELD_COUNT; i++)
+        {
+            _stats.rangeErrors[i] += (errors >> (FrameDecoder::RANGE_ERROR_SHIFT + i)) & 1;
+        }
+        return false;
+    }
+    if (!bSuccess)
+    {
+        return false;
+    }
+    _utcOffset = _tzd.getSecondsOffset(pdata);
+    *pEpoch = _epoch.update(frame, _utcOffset);
+    _frame = frame;
+    return true;
 }
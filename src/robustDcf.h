@@ -19,25 +19,187 @@
 #pragma once
 #include "phaseDetector.h"
 #include "secondsDecoder.h"
-#include "bcdDecoder.h"
+#include "frameDecoder.h"
 #include "timezoneDecoder.h"
-#include <Timezone.h>
+#include "epochCalculator.h"
+#include "ringBuffer.h"
+#ifdef ARDUINO
 #include <Chronos.h>
-#include "AsyncDelay.h"
+#endif
+
+#ifndef ROBUSTDCF_MAX_FRAME_DISTANCE
+#define ROBUSTDCF_MAX_FRAME_DISTANCE 6
+#endif
+
+#ifndef ROBUSTDCF_EVENT_QUEUE_SIZE
+#define ROBUSTDCF_EVENT_QUEUE_SIZE 8
+#endif
+
+#ifndef ROBUSTDCF_MAX_SUBSCRIBERS
+#define ROBUSTDCF_MAX_SUBSCRIBERS 4
+#endif
 
 class RobustDcf
 {
 public:
+	typedef struct
+	{
+		Chronos::EpochTime unixEpoch; //!<current UTC time, whole seconds
+		uint16_t milliseconds;		  //!<0-999, fraction of the current second
+		uint16_t microseconds;		  //!<0-999, fraction of the current ms, from the phase of the pulses that is interpolated between the bins
+		uint16_t latency;			  //!<ms between the start of the last DCF second and the return of update()
+		uint16_t error;				  //!<estimated error in ms, grows while the signal is lost
+		bool holdover;				  //!<the signal is lost, the time is kept by millis()
+	} UTC_TIME;
+	typedef struct
+	{
+		uint32_t phaseLockTime;								   //!<ms from init() to the first second tick, 0 while not locked
+		uint32_t minuteLockTime;							   //!<ms from init() to the minute sync, 0 while not synced
+		uint32_t seconds;									   //!<second ticks
+		uint32_t unknownPulses;								   //!<second ticks of which the pulse length was unclear
+		uint32_t minutes;									   //!<complete minutes received while synced
+		uint32_t decodedMinutes;							   //!<minutes that have been decoded
+		uint32_t correctedMinutes;							   //!<decoded minutes that failed the checks, but matched a predicted minute
+		uint32_t rejectedMinutes;							   //!<minutes that passed the checks, but contradicted the confirmed time
+		uint16_t parityErrors[FrameDecoder::PARITY_GROUP_COUNT]; //!<per parity group : minutes, hours, date
+		uint16_t rangeErrors[FrameDecoder::FIELD_COUNT];	   //!<per field : minute, hour, day, weekday, month, year
+		uint16_t repairedBits;								   //!<weak bits that have been flipped to pass the parity check
+		uint16_t watchdogResets;							   //!<restarts because the second ticks stopped, without a time to hold over
+		uint16_t holdovers;									   //!<times the signal was lost while the time was known
+		uint16_t phaseCorrections;							   //!<moves of the pulse start by one bin, after the phase lock
+		uint16_t droppedBins;								   //!<bins lost because update() wasn't called in time
+		uint32_t skippedBins;								   //!<bins that weren't sampled nor correlated in low power
+		int32_t phasePeak;									   //!<correlation of the phase lock
+		int32_t phaseMargin;								   //!<phasePeak minus the best alternative phase
+		int16_t minuteMargin;								   //!<score of the minute start minus the runner-up
+		int32_t drift;										   //!<ppb that millis() runs fast compared to DCF77, 0 until estimated
+		uint16_t droppedEvents;								   //!<events lost because dispatchEvents() wasn't called in time
+	} STATISTICS;
+	typedef enum
+	{
+		SECOND_TICK = 0x01,				  //!<a new second has started, while the time is known
+		MINUTE_DECODED = 0x02,			  //!<a minute has been decoded or corrected, on second 59
+		PHASE_LOCKED = 0x04,			  //!<the second ticks have started and carry a clear pulse
+		PHASE_LOST = 0x08,				  //!<the second ticks have stopped, or 10 seconds in a row had no clear pulse
+		TIMEZONE_CHANGE_ANNOUNCED = 0x10, //!<the first decoded minute of an announcement of the change to or from summer time
+		ALL_EVENTS = 0x1F
+	} EVENT_TYPE;
+	typedef struct
+	{
+		EVENT_TYPE type;
+		uint32_t millis;			  //!<millis() at the start of the second of the event.  For MINUTE_DECODED, that's the second 0 that starts next.
+		Chronos::EpochTime unixEpoch; //!<UTC time of that second, only when timeValid
+		bool timeValid;				  //!<there has been a fix, so unixEpoch is known
+		bool holdover;				  //!<the time is kept by millis()
+		uint16_t error;				  //!<estimated error of unixEpoch in ms
+		FrameDecoder::FRAME frame;	  //!<MINUTE_DECODED and TIMEZONE_CHANGE_ANNOUNCED : the local time of the minute that starts next
+	} EVENT;
+	typedef void (*eventHandler)(const EVENT &event);
+	static const uint8_t STATE_VERSION = 1;													   //!<format of saveState(), increased when it changes
+	static const size_t STATE_SIZE = 22 + ROBUSTDCF_BIN_COUNT + SecondsDecoder::SECONDS_PER_MINUTE; //!<bytes written by saveState()
+	static const uint32_t UNKNOWN_ELAPSED = UINT32_MAX;										   //!<restoreState() : the time since saveState() isn't known
 	RobustDcf(const byte inputPin, bool pulseHighPolarity);
+	RobustDcf(const byte *inputPins, const uint8_t *weights, const uint8_t receiverCount, bool pulseHighPolarity);
 	void init();
+	void process_samples(const uint32_t *packedBits, const size_t nSamples);
+	void process_samples(const uint32_t *const *packedStreams, const size_t nSamples);
+	bool process_edge(const uint32_t timestamp, const bool level);
+	void process_edges(const uint32_t now);
+	void setLowPower(const bool enable);
 	bool update(Chronos::EpochTime &unixEpoch);
+	bool update(UTC_TIME &time);
 	bool updateClock(SecondsDecoder::BITDATA *data, Chronos::EpochTime *pEpoch);
+	bool subscribe(const uint8_t eventTypes, eventHandler handler);
+	void unsubscribe(eventHandler handler);
+	bool process();
+	uint8_t dispatchEvents();
+	uint8_t getPartialFrame(FrameDecoder::FRAME &frame);
+	void getStatistics(STATISTICS &stats);
+	size_t saveState(uint8_t *buffer, size_t size);
+	bool restoreState(const uint8_t *buffer, size_t size, uint32_t elapsed = UNKNOWN_ELAPSED);
+	void clearStatistics();
+	static int16_t germanUtcOffset(Chronos::EpochTime unixEpoch);
 
 private:
-	bool getUnixEpochTime(Chronos::EpochTime *unixEpoch);
+	friend class StageBench;
+	static const uint32_t WATCHDOG_TIMEOUT = 10000;		//!<ms without second ticks before the decoder restarts
+	static const uint32_t HOLDOVER_DELAY = 1500;		//!<ms without second ticks before the time is kept by millis()
+	static const uint8_t LOST_SIGNAL_SECONDS = 10;		//!<consecutive second ticks without a pulse or with an unclear pulse, before holdover
+	static const uint16_t MAX_HOLDOVER_ERROR = 400;		//!<ms, beyond which the time is no longer known
+	static const uint16_t TICK_ERROR = 10;				//!<ms, resolution of the second ticks
+	static const uint32_t DRIFT_INTERVAL = 1800;		//!<s between the decoded minutes that are used to measure the drift of millis()
+	static const int32_t MAX_DRIFT = 10000000;			//!<ppb, larger drift measurements are decoding errors
+	static const uint32_t DRIFT_UNCERTAINTY = 2000;		//!<ppb, error of the estimated drift, e.g. due to temperature changes
+	static const uint32_t UNKNOWN_DRIFT_UNCERTAINTY = 100000; //!<ppb, error of millis() before the drift has been estimated
+	static const uint8_t MIN_PREDICTED_BITS = 12;		//!<number of received bits that must match the predicted time
+	static const uint16_t MAX_PRESET_ERROR = 50;		//!<ms, beyond which a restored phase is of no use
+	static const uint16_t MAX_MATCH_ERROR = 60000;		//!<ms, beyond which the received minutes aren't matched with predicted ones
+	static const uint8_t MIN_FRAME_MARGIN = 4;			//!<distance by which the best matching minute must beat the others
+	static const uint8_t STATE_PHASE_LOCKED = 0x01;		//!<flags of the saved state
+	static const uint8_t STATE_MINUTE_SYNCED = 0x02;
+	static const uint8_t STATE_FIX_VALID = 0x04;
+	static const uint8_t STATE_DRIFT_VALID = 0x08;
+	static void secondsTick(void *context, const bool isSyncMark, const SECONDS_DATA pulseLength, const SOFT_PULSE soft);
+	bool nextSecond();
+	bool predictSecond(uint32_t secondStart);
+	void queueEvent(const EVENT_TYPE type, const uint32_t ms);
+	void setPhaseLocked(const bool locked, const uint32_t ms);
+	void setFix(Chronos::EpochTime unixEpoch, uint32_t secondStart);
+	void updateDrift(Chronos::EpochTime unixEpoch, uint32_t secondStart);
+	uint32_t sinceFix(uint32_t ms);
+	uint16_t holdoverError(uint32_t ms);
+	void enterHoldover();
+	bool holdoverSecond(UTC_TIME &time);
+	uint64_t predictFrame(Chronos::EpochTime unixEpoch);
+	bool predictEpoch(uint32_t secondStart, Chronos::EpochTime &unixEpoch);
+	bool plausible(Chronos::EpochTime unixEpoch, uint32_t secondStart);
+	bool matchFrame(const SecondsDecoder::BITDATA *data, uint32_t secondStart, Chronos::EpochTime &unixEpoch);
 	PhaseDetector _pd;
 	SecondsDecoder _sd;
-	BcdDecoder _minutes, _hours, _days, _months, _years;
+	FrameDecoder::FRAME _frame; //!<local time of the last decoded minute
 	TimeZoneDecoder _tzd;
-	AsyncDelay _watchDog;
+	EpochCalculator _epoch;
+	uint32_t _lastTick = 0;
+	Chronos::EpochTime _secondEpoch = 0; //!<UTC time of the start of the last second tick
+	uint32_t _secondMillis = 0;			 //!<millis() at the start of that second
+	bool _secondEpochValid = false;		 //!<there has been a fix since init()
+	bool _newSecond = false;			 //!<the last second tick started a new second
+	bool _minuteDecoded = false;		 //!<the last second tick completed a valid minute
+	int16_t _utcOffset = 0;				 //!<seconds, of the last decoded minute
+	Chronos::EpochTime _lastFixEpoch = 0; //!<UTC time of the second of the last fix, kept by init()
+	uint32_t _lastFixMillis = 0;		 //!<millis() at the start of that second
+	bool _lastFixValid = false;
+	bool _fixConfirmed = false;			 //!<the last fix has been predicted by the fix before it
+	Chronos::EpochTime _contradictionEpoch = 0; //!<decoded minute that contradicted the confirmed time, see plausible()
+	uint32_t _contradictionMillis = 0;
+	bool _contradictionValid = false;
+	bool _holdover = false;				 //!<the signal is lost : the time comes from millis() until the ticks match the predicted time
+	uint8_t _badSeconds = 0;			 //!<consecutive second ticks without a clear pulse
+	bool _secondTicked = false;			 //!<set by secondsTick(), with the results of the second below
+	bool _syncMark = false;
+	SECONDS_DATA _clockPulseLength = UNKNOWNPULSE;
+	SOFT_PULSE _softPulse = {0, 0};
+	bool _previousSyncMark = false;
+	int32_t _drift = 0;					 //!<ppb that millis() runs fast, kept by init()
+	bool _driftValid = false;
+	Chronos::EpochTime _driftAnchorEpoch = 0; //!<decoded minute from which the drift is measured
+	uint32_t _driftAnchorMillis = 0;
+	bool _driftAnchorValid = false;
+	int8_t _restoredMinute[SecondsDecoder::SECONDS_PER_MINUTE]; //!<minute histogram of restoreState(), until the time is confirmed
+	bool _restoredMinuteValid = false;
+	STATISTICS _stats = {};
+	uint32_t _initTime = 0;				 //!<millis() of init()
+	uint16_t _phaseCorrectionsBase = 0; //!<counters of the phase detector at the last clearStatistics()
+	uint16_t _droppedBinsBase = 0;
+	uint32_t _skippedBinsBase = 0;
+	typedef struct
+	{
+		uint8_t eventTypes;
+		eventHandler handler;
+	} SUBSCRIPTION;
+	SUBSCRIPTION _subscriptions[ROBUSTDCF_MAX_SUBSCRIBERS] = {};
+	uint8_t _eventTypes = 0;		 //!<the events that have a handler, only these are queued
+	RingBuffer<EVENT, ROBUSTDCF_EVENT_QUEUE_SIZE> _events;
+	bool _phaseLocked = false;		 //!<the second ticks carry a clear pulse, for PHASE_LOCKED and PHASE_LOST
+	bool _changeAnnounced = false;	 //!<the last decoded minute announced a time zone change
 };
@@ -23,7 +23,7 @@
  */
 #include "secondsDecoder.h"
 
-SecondsDecoder::SecondsDecoder() : _bin(SECONDS_PER_MINUTE) {}
+SecondsDecoder::SecondsDecoder() {}
 
 /**
  * @brief Each second, pulse data comes in.  It gets shifted into the bit shifter.
@@ -37,42 +37,48 @@ SecondsDecoder::SecondsDecoder() : _bin(SECONDS_PER_MINUTE) {}
  *  - even parity over bits 29–35
  *  - even parity over date bits 36–58
  *  - sync mark on second 59
- * @param isSyncMark true when this second is the first second of the minute.
+ * Markers that depend on a weak bit don't count, the sync mark counts as much as it is clear.  So noisy seconds count for less.
  * @param pulseLength pulse length of the current second.
+ * @param soft soft decisions of the current second : pulse length and sync mark, i.e. whether this is the last second of the minute.
  */
-void SecondsDecoder::updateSeconds(const bool isSyncMark, const SECONDS_DATA pulseLength)
+void SecondsDecoder::updateSeconds(const SECONDS_DATA pulseLength, const SOFT_PULSE soft)
 {
-    //Serial.printf("%d %d\r\n", isSyncMark, pulseLength);
+    const uint64_t NEWEST_BIT = 0x800000000000000U;
     _curData.validBitCtr++;
-     //Shift in new data from right to left (because LSb is sent first)
-   _curData.bitShifter >>= 1;
-    if (pulseLength == LONGPULSE)
+    //Shift in new data from right to left (because LSb is sent first)
+    _curData.bitShifter >>= 1;
+    _curData.weakBits >>= 1;
+    //An unclear pulse gets its most likely length, but it's marked as weak
+    if (pulseLength == LONGPULSE || (pulseLength == UNKNOWNPULSE && soft.pulse > 0))
     {
-        _curData.bitShifter |= 0x800000000000000U;
+        _curData.bitShifter |= NEWEST_BIT;
     }
-    if (isSyncMark || (pulseLength != UNKNOWNPULSE))
+    if (pulseLength == UNKNOWNPULSE || (soft.pulse < WEAK_PULSE && soft.pulse > -WEAK_PULSE))
     {
-        int8_t score = 0;
-        //Detect 0-bit on second 0
-        score += _curData.bitShifter & 1 ? -1 : 1;
-        //Detect bit 17 and bit 18 are different;
-        score += ((_curData.bitShifter ^ (_curData.bitShifter >> 1)) & 0x20000) ? 1 : -1;
-        //Detect 1-bit on second 20
-        score += _curData.bitShifter & 0x100000U ? 1 : -1;
-        //Detect even parity over bits 21-28
-        uint32_t parityCheck = _curData.bitShifter & 0x1FE00000;
-        score += dataValid(parityCheck) ? 1 : -1;
-        //Compiler bug : & bit operations on uint64 don't work.  Only the lower 32bits are taken into account.
-        //Detect even parity over bits 29–35
-        parityCheck = (_curData.bitShifter >> 4) & 0xFE000000;
-        score += dataValid(parityCheck) & 1 ? 1 : -1;
-        //Detect even parity over bits 36–58
-        parityCheck = (_curData.bitShifter >> 28) & 0x7fffff00;
-        score += dataValid(parityCheck) & 1 ? 1 : -1;
-        //Detect sync mark on second 59
-        score += (isSyncMark && (pulseLength == SHORTPULSE)) ? 6 : -6;
-        _bin.add(_activeBin, score);
+        _curData.weakBits |= NEWEST_BIT;
     }
+    const uint64_t bits = _curData.bitShifter, weak = _curData.weakBits;
+    int8_t score = 0;
+    //Detect 0-bit on second 0
+    score += weak & 1 ? 0 : (bits & 1 ? -1 : 1);
+    //Detect bit 17 and bit 18 are different;
+    score += weak & 0x60000 ? 0 : (((bits ^ (bits >> 1)) & 0x20000) ? 1 : -1);
+    //Detect 1-bit on second 20
+    score += weak & 0x100000 ? 0 : (bits & 0x100000 ? 1 : -1);
+    //Detect even parity over bits 21-28
+    uint32_t parityCheck = bits & 0x1FE00000;
+    score += weak & 0x1FE00000 ? 0 : (dataValid(parityCheck) ? 1 : -1);
+    //Compiler bug : & bit operations on uint64 don't work.  Only the lower 32bits are taken into account.
+    //Detect even parity over bits 29–35
+    parityCheck = (bits >> 4) & 0xFE000000;
+    score += (weak >> 4) & 0xFE000000 ? 0 : (dataValid(parityCheck) & 1 ? 1 : -1);
+    //Detect even parity over bits 36–58
+    parityCheck = (bits >> 28) & 0x7fffff00;
+    score += (weak >> 28) & 0x7fffff00 ? 0 : (dataValid(parityCheck) & 1 ? 1 : -1);
+    //Detect sync mark on second 59 : no pulse at all, so also a short one
+    const int8_t syncMark = soft.syncMark < -soft.pulse ? soft.syncMark : -soft.pulse;
+    score += SYNC_MARK_SCORE * syncMark / SOFT_SCALE;
+    _bin.add(_activeBin, score);
 
     _minuteStartBin = _bin.maximum(LOCK_THRESHOLD);
 
@@ -83,7 +89,7 @@ void SecondsDecoder::updateSeconds(const bool isSyncMark, const SECONDS_DATA pul
     if (getSecond(second) && second == 59)
     {
         _prevData = _curData;
-        _curData = {0, 0};
+        _curData = {0, 0, 0};
     }
 }
 
@@ -116,11 +122,100 @@ bool SecondsDecoder::getTimeData(BITDATA *pdata)
     return _minuteStartBin != INVALID;
 }
 
+/**
+ * @brief Get the bits that have been received so far in the current minute.
+ * @param pdata bit 0 is the first second of the minute, validBitCtr is the number of seconds received.
+ * @returns true when clock synced.  If false, then the data from the parameter should be discarded.
+ */
+bool SecondsDecoder::getPartialData(BITDATA *pdata)
+{
+    uint8_t second;
+    if (!getSecond(second))
+    {
+        return false;
+    }
+    if (second == SECONDS_PER_MINUTE - 1)
+    {
+        //The minute is complete, it has already been moved to the data of the previous minute.
+        *pdata = _prevData;
+        return true;
+    }
+    //The newest bit is at bit 59.
+    pdata->bitShifter = _curData.bitShifter >> (SECONDS_PER_MINUTE - 1 - second);
+    pdata->weakBits = _curData.weakBits >> (SECONDS_PER_MINUTE - 1 - second);
+    pdata->validBitCtr = min(_curData.validBitCtr, (uint8_t)(second + 1));
+    return true;
+}
+
+/**
+ * @brief Get the bits of the last 60 seconds, whether the clock is synced or not.
+ * @param pdata the newest bit is at bit 59.  validBitCtr is the number of seconds that have been received.
+ */
+void SecondsDecoder::getRecentBits(BITDATA *pdata)
+{
+    *pdata = _curData;
+}
+
+/**
+ * @brief Add evidence for the minute start when the current second is known from elsewhere, e.g. from a prediction.
+ * It gets the same weight as the lock threshold, so the decoder syncs right away unless other bins have a stronger score.
+ * @param second the current second, the same value that getSecond() would return.
+ */
+void SecondsDecoder::presetSecond(const uint8_t second)
+{
+    const uint8_t minuteStartBin = ((SECONDS_PER_MINUTE << 1) + _activeBin - 2 - second) % SECONDS_PER_MINUTE;
+    _bin.add(minuteStartBin, LOCK_THRESHOLD);
+    _minuteStartBin = _bin.maximum(LOCK_THRESHOLD);
+}
+
+/**
+ * @brief Snapshot of the minute histogram, e.g. to be stored before powering down.
+ * @param bins receives SECONDS_PER_MINUTE values, starting at the bin of the minute start
+ * @returns false when the clock isn't synced, bins is left untouched then.
+ */
+bool SecondsDecoder::getMinuteState(int8_t *bins)
+{
+    if (_minuteStartBin == INVALID)
+    {
+        return false;
+    }
+    for (uint8_t i = 0; i < SECONDS_PER_MINUTE; i++)
+    {
+        const int32_t value = _bin.get((_minuteStartBin + i) % SECONDS_PER_MINUTE);
+        bins[i] = value < INT8_MIN ? INT8_MIN : (value > INT8_MAX ? INT8_MAX : value);
+    }
+    return true;
+}
+
+/**
+ * @brief Restore a minute histogram saved by getMinuteState(), once the current second is known from elsewhere.
+ * Like presetSecond(), but the history of the other bins comes back too, so that a later bad minute doesn't move the sync.
+ * @param bins SECONDS_PER_MINUTE values, starting at the bin of the minute start
+ * @param second the current second, the same value that getSecond() would return.
+ */
+void SecondsDecoder::presetMinute(const int8_t *bins, const uint8_t second)
+{
+    const uint8_t minuteStartBin = ((SECONDS_PER_MINUTE << 1) + _activeBin - 2 - second) % SECONDS_PER_MINUTE;
+    for (uint8_t i = 0; i < SECONDS_PER_MINUTE; i++)
+    {
+        _bin.set((minuteStartBin + i) % SECONDS_PER_MINUTE, bins[i]);
+    }
+    presetSecond(second);
+}
+
+/**
+ * @brief Score of the most likely minute start minus that of the runner-up.  The higher, the more reliable the minute sync.
+ */
+int16_t SecondsDecoder::getMinuteMargin()
+{
+    return _bin.margin();
+}
+
 void SecondsDecoder::clear()
 {
     _bin.clear();
     _activeBin = 0;
-    _prevData = _curData = {0, 0};
+    _prevData = _curData = {0, 0, 0};
     _minuteStartBin = INVALID;
 }
 
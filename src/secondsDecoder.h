@@ -20,7 +20,7 @@
  * It also holds the databits for the next minute and transfers these on the start of each minute to other objects.
  */
 #pragma once
-#include "Arduino.h"
+#include "platform.h"
 #include "bin.h"
 
 typedef enum
@@ -30,6 +30,17 @@ typedef enum
 	UNKNOWNPULSE
 } SECONDS_DATA;
 
+static const int8_t SOFT_SCALE = 100; //soft decisions range from -SOFT_SCALE to SOFT_SCALE
+
+/**
+ * @brief Soft decision of a second : how clear the pulse was, before it got reduced to SECONDS_DATA and a sync mark flag.
+ */
+typedef struct
+{
+	int8_t syncMark; //!<first 100ms : positive when the pulse was missing, i.e. a sync mark
+	int8_t pulse;	 //!<100ms to 200ms : positive for a long pulse, negative for a short pulse
+} SOFT_PULSE;
+
 class SecondsDecoder
 {
 public:
@@ -37,19 +48,28 @@ public:
 	{
 		uint64_t bitShifter;	//!<the received bits in a single minute
 		uint8_t validBitCtr;	//!<the number of valid bits in bitShifter.  Each second, this counter increases.  It gets cleared at the end of the minute.
+		uint64_t weakBits;		//!<the bits of bitShifter of which the pulse length was unclear.  Their value is the most likely one.
 	} BITDATA;
-	static const uint8_t SECONDS_PER_MINUTE = 60;
+	static constexpr uint8_t SECONDS_PER_MINUTE = 60;
 	SecondsDecoder();
-	void updateSeconds(const bool isSyncMark, const SECONDS_DATA pulseLength);
+	void updateSeconds(const SECONDS_DATA pulseLength, const SOFT_PULSE soft);
 	bool getSecond(uint8_t &second);
 	bool getTimeData(BITDATA *pdata);
+	bool getPartialData(BITDATA *pdata);
+	void getRecentBits(BITDATA *pdata);
+	void presetSecond(const uint8_t second);
+	bool getMinuteState(int8_t *bins);
+	void presetMinute(const int8_t *bins, const uint8_t second);
+	int16_t getMinuteMargin();
 	void clear();
 private:
 	static const int8_t LOCK_THRESHOLD = 7;
+	static const int8_t WEAK_PULSE = 70;	//soft pulse decisions below this are weak bits
+	static const int8_t SYNC_MARK_SCORE = 6; //score of a clear sync mark, soft decisions get less
 	bool dataValid(uint64_t x);
-	Bin _bin;
+	Bin<SECONDS_PER_MINUTE> _bin;
 	uint8_t _activeBin = 0;
-	BITDATA _curData = {0, 0};
-	BITDATA _prevData = {0, 0};
+	BITDATA _curData = {0, 0, 0};
+	BITDATA _prevData = {0, 0, 0};
 	uint8_t _minuteStartBin = INVALID;
 };
@@ -27,64 +27,71 @@ bool TimeZoneDecoder::update(SecondsDecoder::BITDATA *data)
         //not enough valid samples in the data buffer
         return false;
     }
-    if ((data->bitShifter & CEST_BIT) && (_isSummerTime < INT8_MAX))
+    if (isClear(data) && ((data->bitShifter & CEST_BIT) ? _isSummerTime < 0 : _isSummerTime > 0))
     {
-        _isSummerTime++;
+        //The time zone has changed : the votes for the old one no longer count
+        _isSummerTime = 0;
     }
-    if ((data->bitShifter & CET_BIT) && (_isSummerTime > INT8_MIN))
+    //Weak bits don't get a vote, unless there's nothing better yet
+    const bool clear = !(data->weakBits & (CEST_BIT | CET_BIT)) || !_isSummerTime;
+    if (clear && (data->bitShifter & CEST_BIT) && (_isSummerTime < INT8_MAX))
     {
-        _isSummerTime--;
-    }
-    if (data->bitShifter & TIMEZONE_CHANGE_BIT)
-    {
-        if (_timeZoneChangeAnnounced < UINT8_MAX)
-        {
-            _timeZoneChangeAnnounced++;
-        }
+        _isSummerTime++;
     }
-    else
+    if (clear && (data->bitShifter & CET_BIT) && (_isSummerTime > INT8_MIN))
     {
-        if (_timeZoneChangeAnnounced > 0)
-        {
-            _timeZoneChangeAnnounced--;
-        }
+        _isSummerTime--;
     }
     return true;
 }
 
-bool TimeZoneDecoder::getSecondsOffset(int16_t &offset, uint8_t &hour, uint8_t minute)
+/**
+ * @brief Seconds that the local time of the minute is ahead of UTC.
+ * The CEST and CET bits of the minute itself are used when they're unambiguous, so that the offset switches in the first
+ * minute after a time zone change.  Otherwise, the votes of the previous minutes decide.
+ */
+int16_t TimeZoneDecoder::getSecondsOffset(const SecondsDecoder::BITDATA *data)
 {
-    if ((!minute) && _timeZoneChangeAnnounced > 0)
+    if (isClear(data))
     {
-        switch (hour)
-        {
-        case 3:
-            if ((_isSummerTime > 0))
-            {
-                //First minute of winter time
-                hour--; //Correct hour reading: should have been read as 2, but due to binning will be read as 3.
-                _isSummerTime = -1;
-            }
-            break;
-        case 2:
-            if ((_isSummerTime < 0))
-            {
-                //First minute of summer time
-                hour++; //Correct hour reading: should have been read as 3, but due to binning will be read as 2.
-                _isSummerTime = 1;
-            }
-            break;
-        default:
-            break;
-        }
+        return (data->bitShifter & CEST_BIT) ? TWO_HOURS : ONE_HOUR;
     }
-    offset = _isSummerTime > 0 ? TWO_HOURS : ONE_HOUR;
-    return true;
+    return _isSummerTime > 0 ? TWO_HOURS : ONE_HOUR;
+}
+
+/**
+ * @brief Exactly one of the CEST and CET bits is set, and neither of them is weak.
+ */
+bool TimeZoneDecoder::isClear(const SecondsDecoder::BITDATA *data)
+{
+    return !(data->weakBits & (CEST_BIT | CET_BIT)) && !(data->bitShifter & CEST_BIT) != !(data->bitShifter & CET_BIT);
 }
 
 void TimeZoneDecoder::clear()
 {
-    _timeZoneChangeAnnounced = 0;
-	_isSummerTime = 0;
-	_isPredictionCEST = false;
-}
\ No newline at end of file
+    _isSummerTime = 0;
+}
+
+/**
+ * @brief Balance of the CEST and CET bits received so far.  Positive means summer time.
+ */
+int8_t TimeZoneDecoder::getSummerTimeVotes()
+{
+    return _isSummerTime;
+}
+
+/**
+ * @brief Restore the balance returned by getSummerTimeVotes(), e.g. after a restart.
+ */
+void TimeZoneDecoder::presetSummerTimeVotes(const int8_t votes)
+{
+    _isSummerTime = votes;
+}
+
+/**
+ * @brief The A1 bit of the minute is set and it isn't weak : the change to or from summer time is at the end of the hour.
+ */
+bool TimeZoneDecoder::isChangeAnnounced(const SecondsDecoder::BITDATA *data)
+{
+    return (data->bitShifter & TIMEZONE_CHANGE_BIT) && !(data->weakBits & TIMEZONE_CHANGE_BIT);
+}
@@ -0,0 +1,215 @@
+/*
+ * This file is part of RobustDcf.
+ * 
+ * RobustDcf is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Foobar is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Foobar.  If not, see <https://www.gnu.org/licenses/>.
+ * 
+ * Copyright Christoph Tack, 2018
+*/
+/* Checks Bin against a reference model that keeps each bin in an int32, without an offset.
+ *
+ * Random adds, sets and clears are applied to both, with one bin that saturates most of the time, so that the offset of Bin moves
+ * through several rebases.  Some bins are never updated after the start, so they are pushed down until rebase() limits them.
+ * After each operation, get(), maximum() and margin() of each bin have to match the model.
+ *
+ * Usage : binCheck [--ops <n>] [--seed <n>]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <random>
+#include "bin.h"
+
+//Bin::FLOOR and Bin::REBASE_OFFSET
+static const int32_t FLOOR = -16384;
+static const int32_t REBASE_OFFSET = 8192;
+
+template <uint8_t N, int8_t INIT>
+class BinModel
+{
+public:
+    BinModel() { clear(); }
+
+    bool add(uint8_t index, int8_t value)
+    {
+        if (value8(index) == INT8_MAX && value > 0)
+        {
+            for (uint8_t i = 0; i < N; i++)
+            {
+                _data[i] -= i == index ? 0 : value;
+            }
+            _data[index] = INT8_MAX;
+            _pushed += value;
+            if (_pushed >= REBASE_OFFSET)
+            {
+                rebase();
+            }
+            return true;
+        }
+        _data[index] = clamp8(value8(index) + value);
+        return false;
+    }
+
+    void clear()
+    {
+        _pushed = 0;
+        for (uint8_t i = 0; i < N; i++)
+        {
+            _data[i] = INIT;
+        }
+    }
+
+    void set(uint8_t index, int8_t value) { _data[index] = value; }
+    int32_t get(uint8_t index) const { return _data[index]; }
+
+    uint8_t maximum(int8_t threshold) const
+    {
+        uint8_t leader, runnerUp;
+        rank(leader, runnerUp);
+        const int16_t max2nd = runnerUp == INVALID ? INT8_MIN : value8(runnerUp);
+        return value8(leader) >= threshold && value8(leader) - max2nd >= 2 ? leader : INVALID;
+    }
+
+    int16_t margin() const
+    {
+        uint8_t leader, runnerUp;
+        rank(leader, runnerUp);
+        return runnerUp == INVALID ? 0 : value8(leader) - value8(runnerUp);
+    }
+
+private:
+    static int8_t clamp8(int32_t value) { return value > INT8_MAX ? INT8_MAX : value < INT8_MIN ? INT8_MIN : value; }
+    int8_t value8(uint8_t index) const { return clamp8(_data[index]); }
+
+    //the two highest bins, the lowest index first on equal values
+    void rank(uint8_t &leader, uint8_t &runnerUp) const
+    {
+        leader = runnerUp = INVALID;
+        for (uint8_t i = 0; i < N; i++)
+        {
+            if (leader == INVALID || _data[i] > _data[leader])
+            {
+                runnerUp = leader;
+                leader = i;
+            }
+            else if (runnerUp == INVALID || _data[i] > _data[runnerUp])
+            {
+                runnerUp = i;
+            }
+        }
+    }
+
+    //once the saturated bins have pushed the others down by REBASE_OFFSET, the lowest bins are limited to FLOOR
+    void rebase()
+    {
+        for (uint8_t i = 0; i < N; i++)
+        {
+            _data[i] = _data[i] < FLOOR ? FLOOR : _data[i];
+        }
+        _pushed = 0;
+    }
+
+    int32_t _data[N];
+    int32_t _pushed; //sum of the values added to saturated bins since the last rebase
+};
+
+template <uint8_t N, int8_t INIT>
+static bool check(uint32_t ops, uint32_t seed)
+{
+    static Bin<N, INIT> bin;
+    static BinModel<N, INIT> model;
+    std::mt19937 rng(seed);
+    const uint8_t hot = rng() % (N / 2);
+    uint32_t saturated = 0, rebases = 0, pushed = 0;
+    bin.clear();
+    model.clear();
+    for (uint32_t op = 0; op < ops; op++)
+    {
+        const uint32_t kind = rng() % 100;
+        //bins from N / 2 onwards are only touched by set() and clear(), so they are left behind by the offset
+        const uint8_t index = kind < 60 ? hot : rng() % (N / 2);
+        const int8_t value = kind < 60 ? rng() % 128 : (int8_t)(rng() % 256 - 128);
+        if (kind < 98)
+        {
+            const bool expected = model.add(index, value);
+            if (bin.add(index, value) != expected)
+            {
+                printf("FAIL Bin<%u, %d> op %u : add(%u, %d) returned %d\n", N, INIT, op, index, value, !expected);
+                return false;
+            }
+            saturated += expected;
+            pushed += expected ? value : 0;
+            rebases += pushed >= REBASE_OFFSET;
+            pushed = pushed >= REBASE_OFFSET ? 0 : pushed;
+        }
+        else if (kind < 99 || rng() % 64)
+        {
+            const uint8_t any = rng() % N;
+            bin.set(any, value);
+            model.set(any, value);
+        }
+        else
+        {
+            bin.clear();
+            model.clear();
+            pushed = 0;
+        }
+        for (uint8_t i = 0; i < N; i++)
+        {
+            if (bin.get(i) != model.get(i))
+            {
+                printf("FAIL Bin<%u, %d> op %u : get(%u) is %ld instead of %ld\n", N, INIT, op, i, (long)bin.get(i), (long)model.get(i));
+                return false;
+            }
+        }
+        const int8_t threshold = rng() % 256 - 128;
+        if (bin.maximum(threshold) != model.maximum(threshold) || bin.margin() != model.margin())
+        {
+            printf("FAIL Bin<%u, %d> op %u : maximum(%d) %u, margin %d instead of %u, %d\n", N, INIT, op, threshold,
+                   bin.maximum(threshold), bin.margin(), model.maximum(threshold), model.margin());
+            return false;
+        }
+    }
+    printf("Bin<%u, %d> : %u operations, %u saturated, %u rebases\n", N, INIT, ops, saturated, rebases);
+    if (rebases < 3)
+    {
+        printf("FAIL Bin<%u, %d> : not enough rebases\n", N, INIT);
+        return false;
+    }
+    return true;
+}
+
+int main(int argc, char *argv[])
+{
+    uint32_t ops = 200000, seed = 1;
+    for (int i = 1; i < argc; i++)
+    {
+        if (!strcmp(argv[i], "--ops") && i + 1 < argc)
+        {
+            ops = strtoul(argv[++i], nullptr, 10);
+        }
+        else if (!strcmp(argv[i], "--seed") && i + 1 < argc)
+        {
+            seed = strtoul(argv[++i], nullptr, 10);
+        }
+        else
+        {
+            fprintf(stderr, "Usage : %s [--ops <n>] [--seed <n>]\n", argv[0]);
+            return 1;
+        }
+    }
+    //the bins of the phase detector and of the seconds decoder
+    bool passed = check<100, INT8_MIN>(ops, seed);
+    passed = check<60, 0>(ops, seed) && passed;
+    return passed ? 0 : 1;
+}
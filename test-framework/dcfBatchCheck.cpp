@@ -0,0 +1,236 @@
+/*
+ * This file is part of RobustDcf.
+ * 
+ * RobustDcf is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Foobar is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Foobar.  If not, see <https://www.gnu.org/licenses/>.
+ * 
+ * Copyright Christoph Tack, 2018
+*/
+/* Checks BatchDecoder against RobustDcf::updateClock() on the ".log"-files of https://www.dcf77logs.de/logs, and measures how
+ * fast both of them decode.
+ *
+ * The minute frames of each file are decoded frame by frame with updateClock(), the way dcfLogCheck does, and all at once with
+ * BatchDecoder::decodeFrames().  A file fails when a frame is valid for one and not for the other, or when both give another
+ * time stamp.  Each file is a separate recording, so both decoders start from scratch for each file.
+ *
+ * The throughput of both is printed in million frames per second, the fastest of --repeat runs.  Parsing the files isn't included.
+ * The dcfBatchCheckAvx2 target of the Makefile builds it with -mavx2, to check and measure the AVX2 stage of BatchDecoder.
+ *
+ * Usage : dcfBatchCheck <file or directory> [<file or directory> ...] [--repeat <n>]
+ * Directories are searched recursively for ".log"-files.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <string>
+#include <vector>
+#include "robustDcf.h"
+#include "batchDecoder.h"
+#include "logParser.h"
+
+typedef struct
+{
+    std::string filename;
+    std::vector<uint64_t> frames;
+} LOG_FILE;
+
+static RobustDcf rd(0, true);
+static BatchDecoder batch;
+
+static bool readFrames(LOG_FILE &file)
+{
+    FILE *f = fopen(file.filename.c_str(), "rb");
+    if (!f)
+    {
+        return false;
+    }
+    std::string text;
+    char buffer[65536];
+    for (size_t n; (n = fread(buffer, 1, sizeof(buffer), f)) > 0;)
+    {
+        text.append(buffer, n);
+    }
+    fclose(f);
+    const char *const textEnd = text.data() + text.size();
+    for (const char *line = text.data(); line < textEnd;)
+    {
+        const char *lineEnd = (const char *)memchr(line, '\n', textEnd - line);
+        const char *next = lineEnd ? lineEnd + 1 : textEnd;
+        lineEnd = lineEnd ? lineEnd : textEnd;
+        while (lineEnd > line && (lineEnd[-1] == '\r' || lineEnd[-1] == ' '))
+        {
+            lineEnd--;
+        }
+        uint64_t bits;
+        Chronos::EpochTime expected;
+        if (LogParser::parseLine(line, lineEnd, bits, expected))
+        {
+            file.frames.push_back(bits);
+        }
+        line = next;
+    }
+    return true;
+}
+
+static void addPath(const char *path, std::vector<LOG_FILE> &files)
+{
+    std::error_code ec;
+    if (std::filesystem::is_directory(path, ec))
+    {
+        std::vector<std::string> found;
+        for (auto &entry : std::filesystem::recursive_directory_iterator(path, ec))
+        {
+            if (entry.is_regular_file() && entry.path().extension() == ".log")
+            {
+                found.push_back(entry.path().string());
+            }
+        }
+        std::sort(found.begin(), found.end());
+        for (auto &filename : found)
+        {
+            files.push_back(LOG_FILE{filename, {}});
+        }
+    }
+    else
+    {
+        files.push_back(LOG_FILE{path, {}});
+    }
+}
+
+/**
+ * @brief Decode the frames of a file with updateClock()
+ * @returns the number of valid frames
+ */
+static size_t decodeByClock(const LOG_FILE &file, BatchDecoder::DECODED_MINUTE *out)
+{
+    size_t validCount = 0;
+    rd.init();
+    for (size_t i = 0; i < file.frames.size(); i++)
+    {
+        SecondsDecoder::BITDATA bd = {file.frames[i], SecondsDecoder::SECONDS_PER_MINUTE, 0};
+        out[i].valid = rd.updateClock(&bd, &out[i].unixEpoch);
+        validCount += out[i].valid;
+    }
+    return validCount;
+}
+
+/**
+ * @brief Decode the frames of a file with BatchDecoder
+ * @returns the number of valid frames
+ */
+static size_t decodeByBatch(const LOG_FILE &file, BatchDecoder::DECODED_MINUTE *out)
+{
+    batch.clear();
+    return batch.decodeFrames(file.frames.data(), file.frames.size(), out);
+}
+
+/**
+ * @brief Decode all files and return the time it took in seconds
+ */
+template <class Decoder>
+static double timeDecoder(const std::vector<LOG_FILE> &files, std::vector<std::vector<BatchDecoder::DECODED_MINUTE>> &results, Decoder decode)
+{
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < files.size(); i++)
+    {
+        decode(files[i], results[i].data());
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    return elapsed.count();
+}
+
+int main(int argc, char *argv[])
+{
+    std::vector<LOG_FILE> files;
+    int repeats = 3;
+    for (int i = 1; i < argc; i++)
+    {
+        if (!strcmp(argv[i], "--repeat") && i + 1 < argc)
+        {
+            repeats = std::max(1, atoi(argv[++i]));
+        }
+        else
+        {
+            addPath(argv[i], files);
+        }
+    }
+    if (files.empty())
+    {
+        fprintf(stderr, "Usage : %s <file or directory> [<file or directory> ...] [--repeat <n>]\n", argv[0]);
+        return 1;
+    }
+    size_t frameCount = 0;
+    uint32_t failedFiles = 0;
+    for (auto &file : files)
+    {
+        if (!readFrames(file))
+        {
+            printf("FAIL %s : can't read file\n", file.filename.c_str());
+            failedFiles++;
+        }
+        frameCount += file.frames.size();
+    }
+
+    std::vector<std::vector<BatchDecoder::DECODED_MINUTE>> byClock(files.size()), byBatch(files.size());
+    for (size_t i = 0; i < files.size(); i++)
+    {
+        byClock[i].resize(files[i].frames.size());
+        byBatch[i].resize(files[i].frames.size());
+    }
+    double clockTime = INFINITY, batchTime = INFINITY;
+    for (int i = 0; i < repeats; i++)
+    {
+        clockTime = std::min(clockTime, timeDecoder(files, byClock, decodeByClock));
+        batchTime = std::min(batchTime, timeDecoder(files, byBatch, decodeByBatch));
+    }
+
+    uint64_t valid = 0, mismatches = 0;
+    for (size_t i = 0; i < files.size(); i++)
+    {
+        uint32_t fileMismatches = 0;
+        size_t firstMismatch = 0;
+        for (size_t j = 0; j < files[i].frames.size(); j++)
+        {
+            const BatchDecoder::DECODED_MINUTE &expected = byClock[i][j], &decoded = byBatch[i][j];
+            valid += expected.valid;
+            if (expected.valid != decoded.valid || (expected.valid && expected.unixEpoch != decoded.unixEpoch))
+            {
+                firstMismatch = fileMismatches++ ? firstMismatch : j;
+            }
+        }
+        if (fileMismatches)
+        {
+            const BatchDecoder::DECODED_MINUTE &expected = byClock[i][firstMismatch], &decoded = byBatch[i][firstMismatch];
+            printf("FAIL %s : %u mismatches (first at frame %zu : updateClock %s %ld, decodeFrames %s %ld)\n", files[i].filename.c_str(),
+                   fileMismatches, firstMismatch, expected.valid ? "valid" : "invalid", (long)expected.unixEpoch,
+                   decoded.valid ? "valid" : "invalid", (long)decoded.unixEpoch);
+            failedFiles++;
+        }
+        mismatches += fileMismatches;
+    }
+    printf("%zu files, %u failed, %zu frames, %lu valid, %lu mismatches\n", files.size(), failedFiles, frameCount,
+           (unsigned long)valid, (unsigned long)mismatches);
+    fprintf(stderr, "updateClock %.2f Mframes/s, decodeFrames %.2f Mframes/s%s\n", frameCount / clockTime / 1e6,
+            frameCount / batchTime / 1e6,
+#ifdef __AVX2__
+            " (AVX2)"
+#else
+            ""
+#endif
+    );
+    return failedFiles ? 1 : 0;
+}
@@ -0,0 +1,266 @@
+/*
+ * This file is part of RobustDcf.
+ * 
+ * RobustDcf is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Foobar is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Foobar.  If not, see <https://www.gnu.org/licenses/>.
+ * 
+ * Copyright Christoph Tack, 2018
+*/
+/* Time-to-fix benchmark : decodes synthetic DCF77 signals with a known time, over a range of signal to noise ratios.
+ * For each SNR, a number of runs is made, each with its own start time, phase, noise and impairments.  Each run starts the decoder
+ * from scratch and reports :
+ *   - the time to phase lock : from the start of the run to the first second tick
+ *   - the time to first fix : from the start of the run to the first time stamp
+ *   - the time stamps that don't match the transmitted time : the wrong-fix rate is the ratio of those to all time stamps
+ * Times are given as median and 90th percentile over the runs that got there.
+ *
+ * Options :
+ *   --snr <from>:<to>:<step>   SNR range in dB (default -4:10:2)
+ *   --runs <n>                 runs per SNR (default 10)
+ *   --minutes <n>              length of each run (default 15)
+ *   --seed <n>                 base seed of the random generators (default 1)
+ *   --start <unix epoch>       start time of all runs, e.g. just before a change of the time zone (default : random between 2020 and 2030)
+ *   --flips <probability>      random sample flips on top of the noise
+ *   --jitter <ms>              random shift of each edge
+ *   --distortion <ms>          added to the length of each pulse, negative to shorten them
+ *   --fades <interval>:<length> carrier lost for <length> ms every <interval> ms
+ *   --impulses <rate>:<length>  impulses per second, each <length> ms long
+ *   --csv                      comma separated output with a header line, for scripts
+ *   --write <file>             don't benchmark : write a single run at the first SNR as a sample file for dcfReplay --active-high
+ */
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <vector>
+#include "sampleReplay.h"
+#include "signalGenerator.h"
+
+typedef struct
+{
+    uint32_t runs;
+    uint32_t stamps;
+    uint32_t wrongStamps;
+    std::vector<uint32_t> phaseLockTimes; //!<ms, of the runs that locked
+    std::vector<uint32_t> firstFixTimes;  //!<ms, of the runs that got a time stamp
+} RESULT;
+
+static SignalGenerator *currentSignal;
+static RESULT *currentResult;
+static bool currentFixed;
+
+static void checkEpoch(const uint32_t sampleIndex, const Chronos::EpochTime unixEpoch)
+{
+    //The stamp is the start of the next minute.  It's reported during the minute marker, the last second of the minute.
+    const Chronos::EpochTime now = currentSignal->getTime(sampleIndex);
+    currentResult->stamps++;
+    currentResult->wrongStamps += unixEpoch - now != 1;
+    if (!currentFixed)
+    {
+        currentResult->firstFixTimes.push_back(sampleIndex);
+        currentFixed = true;
+    }
+}
+
+static Chronos::EpochTime runStart(std::mt19937 &rng, Chronos::EpochTime start)
+{
+    //2020-01-01 up to 2030-01-01
+    return start ? start : 1577836800 + rng() % (3653 * 86400UL);
+}
+
+static void benchmark(RobustDcf &rd, const uint8_t *coldState, SignalGenerator::CHANNEL channel, uint32_t runs, uint32_t minutes, uint32_t seed, Chronos::EpochTime start,
+                      RESULT &result)
+{
+    SampleReplay replay(rd);
+    std::vector<uint8_t> samples(minutes * 60000);
+    result.runs = runs;
+    for (uint32_t run = 0; run < runs; run++)
+    {
+        std::mt19937 rng(seed * 1000 + run);
+        SignalGenerator signal(channel, rng());
+        const Chronos::EpochTime runTime = runStart(rng, start);
+        signal.start(runTime, rng() % 1000);
+        signal.render(samples.data(), samples.size());
+        currentSignal = &signal;
+        currentResult = &result;
+        currentFixed = false;
+        //Each run is a cold start : init() would keep the time of the previous run for the holdover
+        replay.init();
+        rd.restoreState(coldState, RobustDcf::STATE_SIZE, 0);
+        replay.run(samples.data(), samples.size(), checkEpoch);
+        RobustDcf::STATISTICS stats;
+        rd.getStatistics(stats);
+        if (stats.phaseLockTime)
+        {
+            result.phaseLockTimes.push_back(stats.phaseLockTime);
+        }
+    }
+}
+
+static float percentile(std::vector<uint32_t> &values, uint8_t percent)
+{
+    if (values.empty())
+    {
+        return NAN;
+    }
+    std::sort(values.begin(), values.end());
+    return values[(values.size() - 1) * percent / 100] / 1000.0f;
+}
+
+static bool writeSamples(const char *filename, SignalGenerator::CHANNEL channel, uint32_t minutes, uint32_t seed, Chronos::EpochTime start)
+{
+    std::mt19937 rng(seed * 1000);
+    SignalGenerator signal(channel, rng());
+    start = runStart(rng, start);
+    const uint16_t phase = rng() % 1000;
+    signal.start(start, phase);
+    std::vector<uint8_t> samples(minutes * 60000);
+    signal.render(samples.data(), samples.size());
+    FILE *f = fopen(filename, "w");
+    if (!f)
+    {
+        return false;
+    }
+    for (size_t i = 0; i < samples.size(); i++)
+    {
+        fputc('0' + samples[i], f);
+        if (i % 1000 == 999)
+        {
+            fputc('\n', f);
+        }
+    }
+    fclose(f);
+    fprintf(stderr, "%u minutes from %ld.%03u\n", minutes, (long)start, phase);
+    return true;
+}
+
+int main(int argc, char *argv[])
+{
+    float snrFrom = -4, snrTo = 10, snrStep = 2;
+    uint32_t runs = 10;
+    uint32_t minutes = 15;
+    uint32_t seed = 1;
+    Chronos::EpochTime start = 0;
+    bool csv = false;
+    const char *writeFile = nullptr;
+    SignalGenerator::CHANNEL channel = SignalGenerator::CLEAN;
+    for (int i = 1; i < argc; i++)
+    {
+        if (!strcmp(argv[i], "--snr") && i + 1 < argc && sscanf(argv[++i], "%f:%f:%f", &snrFrom, &snrTo, &snrStep) >= 1)
+        {
+            snrTo = std::max(snrTo, snrFrom);
+            snrStep = snrStep > 0 ? snrStep : 1;
+        }
+        else if (!strcmp(argv[i], "--runs") && i + 1 < argc)
+        {
+            runs = strtoul(argv[++i], nullptr, 10);
+        }
+        else if (!strcmp(argv[i], "--minutes") && i + 1 < argc)
+        {
+            minutes = strtoul(argv[++i], nullptr, 10);
+        }
+        else if (!strcmp(argv[i], "--seed") && i + 1 < argc)
+        {
+            seed = strtoul(argv[++i], nullptr, 10);
+        }
+        else if (!strcmp(argv[i], "--start") && i + 1 < argc)
+        {
+            start = strtoul(argv[++i], nullptr, 10);
+        }
+        else if (!strcmp(argv[i], "--flips") && i + 1 < argc)
+        {
+            channel.flipRate = strtof(argv[++i], nullptr);
+        }
+        else if (!strcmp(argv[i], "--jitter") && i + 1 < argc)
+        {
+            channel.jitter = strtoul(argv[++i], nullptr, 10);
+        }
+        else if (!strcmp(argv[i], "--distortion") && i + 1 < argc)
+        {
+            channel.pulseDistortion = strtol(argv[++i], nullptr, 10);
+        }
+        else if (!strcmp(argv[i], "--fades") && i + 1 < argc)
+        {
+            sscanf(argv[++i], "%u:%u", &channel.fadeInterval, &channel.fadeLength);
+        }
+        else if (!strcmp(argv[i], "--impulses") && i + 1 < argc)
+        {
+            unsigned length = 0;
+            sscanf(argv[++i], "%f:%u", &channel.impulseRate, &length);
+            channel.impulseLength = length;
+        }
+        else if (!strcmp(argv[i], "--csv"))
+        {
+            csv = true;
+        }
+        else if (!strcmp(argv[i], "--write") && i + 1 < argc)
+        {
+            writeFile = argv[++i];
+        }
+        else
+        {
+            fprintf(stderr, "Usage : %s [--snr <from>:<to>:<step>] [--runs <n>] [--minutes <n>] [--seed <n>] [--start <unix epoch>] [--flips <probability>]"
+                            " [--jitter <ms>] [--distortion <ms>] [--fades <interval>:<length>] [--impulses <rate>:<length>] [--csv] [--write <file>]\n",
+                    argv[0]);
+            return 1;
+        }
+    }
+    if (writeFile)
+    {
+        channel.snr = snrFrom;
+        if (!writeSamples(writeFile, channel, minutes, seed, start))
+        {
+            fprintf(stderr, "Can't write %s\n", writeFile);
+            return 1;
+        }
+        return 0;
+    }
+
+    static RobustDcf rd(SampleReplay::INPUT_PIN, true);
+    uint8_t coldState[RobustDcf::STATE_SIZE];
+    rd.init();
+    rd.saveState(coldState, sizeof(coldState));
+    if (csv)
+    {
+        printf("snr_db,sample_error_rate,runs,phase_locked,phase_lock_median_s,phase_lock_p90_s,fixed,first_fix_median_s,first_fix_p90_s,"
+               "stamps,wrong_stamps,wrong_fix_rate\n");
+    }
+    else
+    {
+        printf("%7s %8s %5s %21s %21s %14s\n", "SNR dB", "flips", "runs", "phase lock s", "first fix s", "wrong fixes");
+        printf("%7s %8s %5s %5s %7s %7s %5s %7s %7s %14s\n", "", "", "", "runs", "median", "p90", "runs", "median", "p90", "");
+    }
+    for (int step = 0; snrFrom + step * snrStep <= snrTo + snrStep / 1000; step++)
+    {
+        channel.snr = snrFrom + step * snrStep;
+        RESULT result = {0, 0, 0, {}, {}};
+        benchmark(rd, coldState, channel, runs, minutes, seed, start, result);
+        const float flips = SignalGenerator::sampleErrorRate(channel.snr);
+        const float wrongRate = result.stamps ? (float)result.wrongStamps / result.stamps : 0;
+        if (csv)
+        {
+            printf("%.2f,%.5f,%u,%zu,%.1f,%.1f,%zu,%.1f,%.1f,%u,%u,%.5f\n", channel.snr, flips, result.runs, result.phaseLockTimes.size(),
+                   percentile(result.phaseLockTimes, 50), percentile(result.phaseLockTimes, 90), result.firstFixTimes.size(),
+                   percentile(result.firstFixTimes, 50), percentile(result.firstFixTimes, 90), result.stamps, result.wrongStamps, wrongRate);
+        }
+        else
+        {
+            printf("%7.1f %7.2f%% %5u %5zu %7.1f %7.1f %5zu %7.1f %7.1f %5u/%-5u %5.2f%%\n", channel.snr, flips * 100, result.runs,
+                   result.phaseLockTimes.size(), percentile(result.phaseLockTimes, 50), percentile(result.phaseLockTimes, 90),
+                   result.firstFixTimes.size(), percentile(result.firstFixTimes, 50), percentile(result.firstFixTimes, 90),
+                   result.wrongStamps, result.stamps, wrongRate * 100);
+        }
+        fflush(stdout);
+    }
+    return 0;
+}
@@ -0,0 +1,245 @@
+/*
+ * This file is part of RobustDcf.
+ * 
+ * RobustDcf is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Foobar is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Foobar.  If not, see <https://www.gnu.org/licenses/>.
+ * 
+ * Copyright Christoph Tack, 2018
+*/
+/* Native verification tool for the ".log"-files that can be downloaded from https://www.dcf77logs.de/logs and https://www.dcf77logs.de/ereignisse.
+ * It does the same check as offline-dcf.py, but without the embedded target in the loop.
+ *
+ * Each line of a log file holds the bits of a minute and the corresponding date string, e.g.
+ *   0 ... 1  So, 27.03.11 03:00:00, SZ
+ * The bits are decoded by RobustDcf::updateClock(), the same code that runs on the target, and the resulting time stamp is
+ * compared with the date string.  The files are memory mapped and parsed in place.  Each thread decodes a file at a time.
+ *
+ * A file fails when a minute is decoded to a time stamp that differs from the date string.  Minutes that the decoder rejects
+ * (e.g. while the time zone isn't known yet) are counted, but don't fail the file.
+ *
+ * Usage : dcfLogCheck <file or directory> [<file or directory> ...] [-j <threads>]
+ * Directories are searched recursively for ".log"-files.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <string>
+#include <thread>
+#include <vector>
+#include "robustDcf.h"
+#include "logParser.h"
+
+typedef struct
+{
+    std::string filename;
+    bool readable;
+    size_t bytes;
+    uint32_t minutes;  //lines with a minute frame
+    uint32_t decoded;  //minutes decoded to the time stamp of the date string
+    uint32_t rejected; //minutes rejected by the decoder
+    uint32_t wrong;    //minutes decoded to another time stamp
+    uint32_t firstWrongLine;
+    Chronos::EpochTime firstWrongExpected;
+    Chronos::EpochTime firstWrongDecoded;
+} FILE_RESULT;
+
+static void checkFile(RobustDcf &rd, FILE_RESULT &result)
+{
+    int fd = open(result.filename.c_str(), O_RDONLY);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) != 0)
+    {
+        if (fd >= 0)
+        {
+            close(fd);
+        }
+        return;
+    }
+    result.readable = true;
+    result.bytes = st.st_size;
+    if (st.st_size == 0)
+    {
+        close(fd);
+        return;
+    }
+    const char *data = (const char *)mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED)
+    {
+        result.readable = false;
+        return;
+    }
+    madvise((void *)data, st.st_size, MADV_SEQUENTIAL);
+
+    //Each file is a separate recording, so the time zone history of the previous file must be forgotten.
+    rd.init();
+    const char *const fileEnd = data + st.st_size;
+    uint32_t lineNr = 0;
+    for (const char *line = data; line < fileEnd; lineNr++)
+    {
+        const char *lineEnd = (const char *)memchr(line, '\n', fileEnd - line);
+        const char *next = lineEnd ? lineEnd + 1 : fileEnd;
+        lineEnd = lineEnd ? lineEnd : fileEnd;
+        while (lineEnd > line && (lineEnd[-1] == '\r' || lineEnd[-1] == ' '))
+        {
+            lineEnd--;
+        }
+        uint64_t bits;
+        Chronos::EpochTime expected;
+        if (LogParser::parseLine(line, lineEnd, bits, expected))
+        {
+            SecondsDecoder::BITDATA bd = {bits, SecondsDecoder::SECONDS_PER_MINUTE, 0};
+            Chronos::EpochTime epoch;
+            result.minutes++;
+            if (!rd.updateClock(&bd, &epoch))
+            {
+                result.rejected++;
+            }
+            else if (epoch == expected)
+            {
+                result.decoded++;
+            }
+            else if (result.wrong++ == 0)
+            {
+                result.firstWrongLine = lineNr + 1;
+                result.firstWrongExpected = expected;
+                result.firstWrongDecoded = epoch;
+            }
+        }
+        line = next;
+    }
+    munmap((void *)data, st.st_size);
+}
+
+static void addFile(const std::string &filename, std::vector<FILE_RESULT> &results)
+{
+    FILE_RESULT result = {};
+    result.filename = filename;
+    results.push_back(result);
+}
+
+static void addPath(const char *path, std::vector<FILE_RESULT> &results)
+{
+    std::error_code ec;
+    if (std::filesystem::is_directory(path, ec))
+    {
+        std::vector<std::string> found;
+        for (auto &entry : std::filesystem::recursive_directory_iterator(path, ec))
+        {
+            if (entry.is_regular_file() && entry.path().extension() == ".log")
+            {
+                found.push_back(entry.path().string());
+            }
+        }
+        std::sort(found.begin(), found.end());
+        for (auto &filename : found)
+        {
+            addFile(filename, results);
+        }
+    }
+    else
+    {
+        addFile(path, results);
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    unsigned threadCount = std::max(1U, std::thread::hardware_concurrency());
+    std::vector<FILE_RESULT> results;
+    for (int i = 1; i < argc; i++)
+    {
+        if (!strcmp(argv[i], "-j") && i + 1 < argc)
+        {
+            threadCount = std::max(1, atoi(argv[++i]));
+        }
+        else
+        {
+            addPath(argv[i], results);
+        }
+    }
+    if (results.empty())
+    {
+        fprintf(stderr, "Usage : %s <file or directory> [<file or directory> ...] [-j <threads>]\n", argv[0]);
+        return 1;
+    }
+    threadCount = std::min<size_t>(threadCount, results.size());
+
+    //The decoders are created up front, because constructing a RobustDcf registers its phase detector in a list that isn't
+    //thread safe.
+    std::vector<RobustDcf *> decoders;
+    for (unsigned i = 0; i < threadCount; i++)
+    {
+        decoders.push_back(new RobustDcf(0, true));
+    }
+    std::atomic<size_t> nextFile(0);
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> threads;
+    for (unsigned i = 0; i < threadCount; i++)
+    {
+        threads.emplace_back([&, i]() {
+            for (size_t j; (j = nextFile++) < results.size();)
+            {
+                checkFile(*decoders[i], results[j]);
+            }
+        });
+    }
+    for (auto &t : threads)
+    {
+        t.join();
+    }
+    for (auto rd : decoders)
+    {
+        delete rd;
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    uint32_t failedFiles = 0;
+    uint64_t minutes = 0, decoded = 0, rejected = 0, wrong = 0, bytes = 0;
+    for (auto &r : results)
+    {
+        if (!r.readable)
+        {
+            printf("FAIL %s : can't read file\n", r.filename.c_str());
+            failedFiles++;
+            continue;
+        }
+        const bool pass = r.wrong == 0;
+        printf("%s %s : %u minutes, %u decoded, %u rejected, %u wrong", pass ? "PASS" : "FAIL", r.filename.c_str(),
+               r.minutes, r.decoded, r.rejected, r.wrong);
+        if (!pass)
+        {
+            printf(" (first at line %u : expected %ld, decoded %ld)", r.firstWrongLine, (long)r.firstWrongExpected, (long)r.firstWrongDecoded);
+            failedFiles++;
+        }
+        printf("\n");
+        minutes += r.minutes;
+        decoded += r.decoded;
+        rejected += r.rejected;
+        wrong += r.wrong;
+        bytes += r.bytes;
+    }
+    printf("%zu files, %u failed, %lu minutes, %lu decoded, %lu rejected, %lu wrong\n", results.size(), failedFiles,
+           (unsigned long)minutes, (unsigned long)decoded, (unsigned long)rejected, (unsigned long)wrong);
+    fprintf(stderr, "%u threads, %.3f s, %.2f Mminutes/s, %.1f MB/s\n", threadCount, elapsed.count(),
+            minutes / elapsed.count() / 1e6, bytes / elapsed.count() / 1e6);
+    return failedFiles ? 1 : 0;
+}
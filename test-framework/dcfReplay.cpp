@@ -0,0 +1,300 @@
+/*
+ * This file is part of RobustDcf.
+ * 
+ * RobustDcf is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Foobar is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Foobar.  If not, see <https://www.gnu.org/licenses/>.
+ * 
+ * Copyright Christoph Tack, 2018
+*/
+/* Native replay tool : decodes a recorded DCF77 signal as fast as possible.
+ * The input file contains one character per 1ms sample : '0' for a low pin level, '1' for a high pin level.  All other characters are ignored.
+ * Each decoded time stamp is printed as "<sample index> <unix epoch>".
+ *
+ * With --packed, the samples are bit-packed and fed in blocks instead of one by one.
+ * With --edges, the samples are converted to time stamped edges, as a pin change interrupt would capture them.
+ * With --low-power, the decoder only samples around the pulses once it's locked.
+ * With --stats, the decoder statistics are printed at the end.
+ * With --seconds, a time stamp is printed each second as "<sample index> <unix epoch>.<microseconds> <latency in ms> <error in ms>",
+ * followed by "holdover" while the signal is lost.
+ * With --events, the decoder is used through its event handlers instead of update().  Each event is printed as
+ * "<sample index> <event> <unix epoch> <error in ms>", with "-" as epoch while the time isn't known, followed by "holdover" while the
+ * signal is lost.  Minute events are followed by the decoded local time.
+ * With --save-state, the state of the decoder is written to a file at the end.  With --restore-state, the decoder starts from such a
+ * file, e.g. to replay the rest of a recording after a restart.  --elapsed gives the ms between saving and the first sample.
+ * When multiple sample files are given, each file is a receiver and the files are decoded together using antenna diversity.
+ *
+ * Usage : dcfReplay <samplefile> [<samplefile> ...] [--active-high] [--packed | --edges] [--low-power] [--seconds | --events] [--stats]
+ *                  [--save-state <file>] [--restore-state <file> [--elapsed <ms>]]
+ */
+#include <stdio.h>
+#include <string.h>
+#include <chrono>
+#include <vector>
+#include "sampleReplay.h"
+
+static void printEpoch(const uint32_t sampleIndex, const Chronos::EpochTime unixEpoch)
+{
+    printf("%u %ld\n", sampleIndex, (long)unixEpoch);
+}
+
+static void printTime(const uint32_t sampleIndex, const RobustDcf::UTC_TIME &time)
+{
+    printf("%u %ld.%03u%03u %u %u%s\n", sampleIndex, (long)time.unixEpoch, time.milliseconds, time.microseconds, time.latency, time.error, time.holdover ? " holdover" : "");
+}
+
+static SampleReplay *eventReplay;
+
+static void printEvent(const RobustDcf::EVENT &event)
+{
+    const char *name = event.type == RobustDcf::SECOND_TICK ? "second" : event.type == RobustDcf::MINUTE_DECODED ? "minute"
+                     : event.type == RobustDcf::PHASE_LOCKED  ? "locked" : event.type == RobustDcf::PHASE_LOST   ? "lost"
+                                                                                                                   : "announced";
+    printf("%u %s ", eventReplay->getSampleCount(), name);
+    if (event.timeValid)
+    {
+        printf("%ld", (long)event.unixEpoch);
+    }
+    else
+    {
+        printf("-");
+    }
+    printf(" %u%s", event.error, event.holdover ? " holdover" : "");
+    if (event.type == RobustDcf::MINUTE_DECODED || event.type == RobustDcf::TIMEZONE_CHANGE_ANNOUNCED)
+    {
+        const FrameDecoder::FRAME &f = event.frame;
+        printf(" 20%02u-%02u-%02u %02u:%02u %s", f.year, f.month, f.day, f.hour, f.minute, f.isSummerTime ? "CEST" : "CET");
+    }
+    printf("\n");
+}
+
+static void printStatistics(RobustDcf &rd)
+{
+    RobustDcf::STATISTICS stats;
+    rd.getStatistics(stats);
+    fprintf(stderr, "phase lock %u ms, minute lock %u ms, %u seconds, %u unknown pulses, %u/%u minutes decoded (%u corrected), %u rejected\n",
+            stats.phaseLockTime, stats.minuteLockTime, stats.seconds, stats.unknownPulses, stats.decodedMinutes, stats.minutes, stats.correctedMinutes,
+            stats.rejectedMinutes);
+    fprintf(stderr, "parity errors %u %u %u, range errors", stats.parityErrors[0], stats.parityErrors[1], stats.parityErrors[2]);
+    for (uint8_t i = 0; i < FrameDecoder::FIELD_COUNT; i++)
+    {
+        fprintf(stderr, " %u", stats.rangeErrors[i]);
+    }
+    fprintf(stderr, ", repaired bits %u, dropped events %u", stats.repairedBits, stats.droppedEvents);
+    fprintf(stderr, "\nwatchdog resets %u, holdovers %u, drift %d ppb, phase corrections %u, dropped bins %u, skipped bins %u, phase peak %d margin %d, minute margin %d\n",
+            stats.watchdogResets, stats.holdovers, stats.drift, stats.phaseCorrections, stats.droppedBins, stats.skippedBins, stats.phasePeak, stats.phaseMargin, stats.minuteMargin);
+}
+
+static bool saveState(const char *filename, RobustDcf &rd)
+{
+    uint8_t state[RobustDcf::STATE_SIZE];
+    const size_t size = rd.saveState(state, sizeof(state));
+    FILE *f = fopen(filename, "wb");
+    if (!f)
+    {
+        return false;
+    }
+    const bool ok = fwrite(state, 1, size, f) == size;
+    fclose(f);
+    return ok;
+}
+
+static bool restoreState(const char *filename, RobustDcf &rd, uint32_t elapsed)
+{
+    uint8_t state[RobustDcf::STATE_SIZE];
+    FILE *f = fopen(filename, "rb");
+    if (!f)
+    {
+        return false;
+    }
+    const size_t size = fread(state, 1, sizeof(state), f);
+    fclose(f);
+    return rd.restoreState(state, size, elapsed);
+}
+
+static bool readSamples(const char *filename, std::vector<uint8_t> &samples)
+{
+    FILE *f = fopen(filename, "rb");
+    if (!f)
+    {
+        return false;
+    }
+    int c;
+    while ((c = fgetc(f)) != EOF)
+    {
+        if (c == '0' || c == '1')
+        {
+            samples.push_back(c - '0');
+        }
+    }
+    fclose(f);
+    return true;
+}
+
+int main(int argc, char *argv[])
+{
+    bool activeHigh = false;
+    bool packed = false;
+    bool edges = false;
+    bool lowPower = false;
+    bool eachSecond = false;
+    bool events = false;
+    bool showStats = false;
+    const char *saveFile = nullptr;
+    const char *restoreFile = nullptr;
+    uint32_t elapsedSinceSave = RobustDcf::UNKNOWN_ELAPSED;
+    std::vector<std::vector<uint8_t>> samples;
+    for (int i = 1; i < argc; i++)
+    {
+        if (!strcmp(argv[i], "--active-high"))
+        {
+            activeHigh = true;
+        }
+        else if (!strcmp(argv[i], "--packed"))
+        {
+            packed = true;
+        }
+        else if (!strcmp(argv[i], "--edges"))
+        {
+            edges = true;
+        }
+        else if (!strcmp(argv[i], "--low-power"))
+        {
+            lowPower = true;
+        }
+        else if (!strcmp(argv[i], "--stats"))
+        {
+            showStats = true;
+        }
+        else if (!strcmp(argv[i], "--seconds"))
+        {
+            eachSecond = true;
+        }
+        else if (!strcmp(argv[i], "--events"))
+        {
+            events = true;
+        }
+        else if (!strcmp(argv[i], "--save-state") && i + 1 < argc)
+        {
+            saveFile = argv[++i];
+        }
+        else if (!strcmp(argv[i], "--restore-state") && i + 1 < argc)
+        {
+            restoreFile = argv[++i];
+        }
+        else if (!strcmp(argv[i], "--elapsed") && i + 1 < argc)
+        {
+            elapsedSinceSave = strtoul(argv[++i], nullptr, 10);
+        }
+        else if (samples.size() < PhaseDetector::MAX_RECEIVERS)
+        {
+            samples.emplace_back();
+            if (!readSamples(argv[i], samples.back()))
+            {
+                fprintf(stderr, "Can't open %s\n", argv[i]);
+                return 1;
+            }
+        }
+    }
+    if (samples.empty())
+    {
+        fprintf(stderr, "Usage : %s <samplefile> [<samplefile> ...] [--active-high] [--packed | --edges] [--low-power] [--seconds | --events] [--stats]"
+                        " [--save-state <file>] [--restore-state <file> [--elapsed <ms>]]\n", argv[0]);
+        return 1;
+    }
+    //All receivers must have the same number of samples
+    size_t count = samples[0].size();
+    for (auto &stream : samples)
+    {
+        count = std::min(count, stream.size());
+    }
+
+    const uint8_t receiverCount = samples.size();
+    byte pins[PhaseDetector::MAX_RECEIVERS];
+    for (uint8_t i = 0; i < receiverCount; i++)
+    {
+        pins[i] = SampleReplay::INPUT_PIN + i;
+    }
+    static RobustDcf rd(pins, nullptr, receiverCount, activeHigh);
+    SampleReplay replay(rd, receiverCount);
+    rd.setLowPower(lowPower);
+    replay.init();
+    if (restoreFile && !restoreState(restoreFile, rd, elapsedSinceSave))
+    {
+        fprintf(stderr, "Can't restore the state from %s\n", restoreFile);
+        return 1;
+    }
+    if (eachSecond)
+    {
+        replay.setSecondsEvent(printTime);
+    }
+    if (events)
+    {
+        eventReplay = &replay;
+        rd.subscribe(RobustDcf::ALL_EVENTS, printEvent);
+        replay.setEventDriven(true);
+    }
+    auto start = std::chrono::steady_clock::now();
+    if (packed)
+    {
+        std::vector<std::vector<uint32_t>> packedBits(receiverCount, std::vector<uint32_t>((count + 31) / 32, 0));
+        const uint32_t *streams[PhaseDetector::MAX_RECEIVERS];
+        for (uint8_t j = 0; j < receiverCount; j++)
+        {
+            for (size_t i = 0; i < count; i++)
+            {
+                packedBits[j][i >> 5] |= (uint32_t)samples[j][i] << (i & 31);
+            }
+            streams[j] = packedBits[j].data();
+        }
+        start = std::chrono::steady_clock::now();
+        replay.runPacked(streams, count, printEpoch);
+    }
+    else if (edges)
+    {
+        //Only the first receiver : there's only one edge input
+        std::vector<EDGE> edgeList;
+        for (size_t i = 0; i < count; i++)
+        {
+            if (!i || samples[0][i] != samples[0][i - 1])
+            {
+                edgeList.push_back({(uint32_t)(i * 1000), samples[0][i] != 0});
+            }
+        }
+        start = std::chrono::steady_clock::now();
+        replay.runEdges(edgeList.data(), edgeList.size(), count, printEpoch);
+    }
+    else
+    {
+        const uint8_t *streams[PhaseDetector::MAX_RECEIVERS];
+        for (uint8_t j = 0; j < receiverCount; j++)
+        {
+            streams[j] = samples[j].data();
+        }
+        replay.run(streams, count, printEpoch);
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    fprintf(stderr, "%u samples (%.1f s of signal), %u receivers, %u time stamps, %.3f s, %.2f Msamples/s\n",
+            replay.getSampleCount(), replay.getSampleCount() / 1000.0, receiverCount, replay.getEpochCount(),
+            elapsed.count(), replay.getSampleCount() / elapsed.count() / 1e6);
+    if (showStats)
+    {
+        printStatistics(rd);
+    }
+    if (saveFile && !saveState(saveFile, rd))
+    {
+        fprintf(stderr, "Can't save the state to %s\n", saveFile);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,118 @@
+/*
+ * This file is part of RobustDcf.
+ * 
+ * RobustDcf is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Foobar is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Foobar.  If not, see <https://www.gnu.org/licenses/>.
+ * 
+ * Copyright Christoph Tack, 2018
+*/
+/* Microbenchmarks of the decoder stages on the host.  See StageBench (examples/stagebench/stageBench.h).
+ * The results are printed as comma separated values : "stage,ops,ns_per_op,cycles_per_op", with a header line.  cycles_per_op is
+ * empty when there's no cycle counter.
+ * With --baseline, the results are compared to an earlier output, e.g. of the last release : the ns per call of the baseline and the
+ * change in % are added to each line.  The exit code is 2 when a stage got slower by more than --tolerance %.
+ *
+ * Usage : dcfStageBench [--ops <n>] [--repeat <n>] [--baseline <csv file> [--tolerance <percent>]]
+ */
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <math.h>
+#include <map>
+#include <string>
+#include "stageBench.h"
+
+static std::map<std::string, float> baseline;
+static float tolerance = 25;
+static bool regression = false;
+
+static void printResult(const StageBench::RESULT &result)
+{
+    printf("%s,%u,%.2f,", result.stage, result.ops, result.nsPerOp);
+    if (!isnan(result.cyclesPerOp))
+    {
+        printf("%.1f", result.cyclesPerOp);
+    }
+    auto reference = baseline.find(result.stage);
+    if (reference != baseline.end())
+    {
+        const float change = (result.nsPerOp / reference->second - 1) * 100;
+        printf(",%.2f,%+.1f", reference->second, change);
+        if (change > tolerance)
+        {
+            regression = true;
+            fprintf(stderr, "%s is %.1f%% slower than the baseline\n", result.stage, change);
+        }
+    }
+    printf("\n");
+}
+
+static bool readBaseline(const char *filename)
+{
+    FILE *f = fopen(filename, "r");
+    if (!f)
+    {
+        return false;
+    }
+    char line[256];
+    while (fgets(line, sizeof(line), f))
+    {
+        char stage[64];
+        unsigned ops;
+        float nsPerOp;
+        if (sscanf(line, "%63[^,],%u,%f", stage, &ops, &nsPerOp) == 3 && nsPerOp > 0)
+        {
+            baseline[stage] = nsPerOp;
+        }
+    }
+    fclose(f);
+    return true;
+}
+
+int main(int argc, char *argv[])
+{
+    uint32_t ops = 1000000;
+    uint8_t repeats = 5;
+    for (int i = 1; i < argc; i++)
+    {
+        if (!strcmp(argv[i], "--ops") && i + 1 < argc)
+        {
+            ops = strtoul(argv[++i], nullptr, 10);
+        }
+        else if (!strcmp(argv[i], "--repeat") && i + 1 < argc)
+        {
+            repeats = strtoul(argv[++i], nullptr, 10);
+        }
+        else if (!strcmp(argv[i], "--baseline") && i + 1 < argc)
+        {
+            if (!readBaseline(argv[++i]))
+            {
+                fprintf(stderr, "Can't open %s\n", argv[i]);
+                return 1;
+            }
+        }
+        else if (!strcmp(argv[i], "--tolerance") && i + 1 < argc)
+        {
+            tolerance = strtof(argv[++i], nullptr);
+        }
+        else
+        {
+            fprintf(stderr, "Usage : %s [--ops <n>] [--repeat <n>] [--baseline <csv file> [--tolerance <percent>]]\n", argv[0]);
+            return 1;
+        }
+    }
+    static StageBench bench(0, ops);
+    printf("stage,ops,ns_per_op,cycles_per_op%s\n", baseline.empty() ? "" : ",baseline_ns_per_op,change_percent");
+    bench.run(printResult, repeats);
+    return regression ? 2 : 0;
+}
@@ -0,0 +1,110 @@
+/*
+ * This file is part of RobustDcf.
+ * 
+ * RobustDcf is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Foobar is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Foobar.  If not, see <https://www.gnu.org/licenses/>.
+ * 
+ * Copyright Christoph Tack, 2018
+*/
+#include <string.h>
+#include "logParser.h"
+
+const char *LogParser::skipSpaces(const char *p, const char *end)
+{
+    while (p < end && *p == ' ')
+    {
+        p++;
+    }
+    return p;
+}
+
+/**
+ * @brief Parse an unsigned decimal number, followed by the separator
+ */
+bool LogParser::parseNumber(const char *&p, const char *end, uint8_t &value, const char separator)
+{
+    if (p >= end || *p < '0' || *p > '9')
+    {
+        return false;
+    }
+    value = 0;
+    while (p < end && *p >= '0' && *p <= '9')
+    {
+        value = value * 10 + *p++ - '0';
+    }
+    return p < end && *p++ == separator;
+}
+
+/**
+ * @brief Convert a date string, e.g. "So, 27.03.11 03:00:00, SZ" to a UTC time stamp.
+ * SZ (Sommerzeit) is UTC+2, WZ (Winterzeit) is UTC+1.
+ */
+bool LogParser::parseDate(const char *p, const char *end, Chronos::EpochTime &epoch)
+{
+    uint8_t day, month, year, hour, minute, second;
+    p = (const char *)memchr(p, ',', end - p);
+    if (!p)
+    {
+        return false;
+    }
+    p = skipSpaces(p + 1, end);
+    if (!parseNumber(p, end, day, '.') || !parseNumber(p, end, month, '.') || !parseNumber(p, end, year, ' '))
+    {
+        return false;
+    }
+    p = skipSpaces(p, end);
+    if (!parseNumber(p, end, hour, ':') || !parseNumber(p, end, minute, ':') || !parseNumber(p, end, second, ','))
+    {
+        return false;
+    }
+    p = skipSpaces(p, end);
+    if (end - p < 2 || p[1] != 'Z' || (p[0] != 'S' && p[0] != 'W'))
+    {
+        return false;
+    }
+    const int32_t utcOffset = p[0] == 'S' ? 7200 : 3600;
+    epoch = EpochCalculator::daysSinceEpoch(year, month, day) * EpochCalculator::SECONDS_PER_DAY + hour * 3600L + minute * 60L - utcOffset;
+    return true;
+}
+
+/**
+ * @brief Parse a line of a log file.  The first digit is the first second of the minute.  Spaces between the bits are ignored.
+ * The bits end at a double space, which is followed by the date string.
+ * @returns false when the line doesn't contain a minute frame
+ */
+bool LogParser::parseLine(const char *p, const char *end, uint64_t &bits, Chronos::EpochTime &epoch)
+{
+    p = skipSpaces(p, end);
+    if (end - p < 2 || p[0] != '0' || p[1] != ' ')
+    {
+        return false;
+    }
+    bits = 0;
+    uint8_t bitCount = 0;
+    for (; p < end && !(p[0] == ' ' && p + 1 < end && p[1] == ' '); p++)
+    {
+        if (*p == '0' || *p == '1')
+        {
+            if (bitCount == 64)
+            {
+                return false;
+            }
+            bits |= (uint64_t)(*p - '0') << bitCount++;
+        }
+        else if (*p != ' ')
+        {
+            return false;
+        }
+    }
+    return p < end && parseDate(p, end, epoch);
+}
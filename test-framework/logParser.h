@@ -0,0 +1,35 @@
+/*
+ * This file is part of RobustDcf.
+ * 
+ * RobustDcf is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Foobar is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Foobar.  If not, see <https://www.gnu.org/licenses/>.
+ * 
+ * Copyright Christoph Tack, 2018
+*/
+/* Parser of the ".log"-files of https://www.dcf77logs.de/logs, shared by the tools that decode them.
+ * Each line of a log file holds the bits of a minute and the corresponding date string, e.g.
+ *   0 ... 1  So, 27.03.11 03:00:00, SZ
+ */
+#pragma once
+#include "robustDcf.h"
+
+class LogParser
+{
+public:
+	static bool parseLine(const char *p, const char *end, uint64_t &bits, Chronos::EpochTime &epoch);
+	static bool parseDate(const char *p, const char *end, Chronos::EpochTime &epoch);
+
+private:
+	static const char *skipSpaces(const char *p, const char *end);
+	static bool parseNumber(const char *&p, const char *end, uint8_t &value, const char separator);
+};
@@ -0,0 +1,200 @@
+/*
+ * This file is part of RobustDcf.
+ * 
+ * RobustDcf is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Foobar is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Foobar.  If not, see <https://www.gnu.org/licenses/>.
+ * 
+ * Copyright Christoph Tack, 2018
+*/
+#include "sampleReplay.h"
+
+extern void HAL_SYSTICK_Callback(void);
+
+static uint8_t currentSamples[PhaseDetector::MAX_RECEIVERS];
+
+static uint8_t replaySample(uint8_t pin)
+{
+    const uint8_t receiver = pin - SampleReplay::INPUT_PIN;
+    return receiver < PhaseDetector::MAX_RECEIVERS ? currentSamples[receiver] : LOW;
+}
+
+SampleReplay::SampleReplay(RobustDcf &rd, const uint8_t receiverCount) : _rd(rd), _receiverCount(receiverCount) {}
+
+/**
+ * @brief Restart the virtual clock and the decoder.
+ */
+void SampleReplay::init()
+{
+    HostShim::setSampleSource(replaySample);
+    HostShim::setMillis(0);
+    _sampleCount = 0;
+    _epochCount = 0;
+    _rd.init();
+}
+
+/**
+ * @brief Get a time stamp each second instead of each minute.  The epochEvent of the run functions is then no longer called.
+ * @param timeDecoded called each second, once the decoder knows the time.  nullptr to go back to time stamps per minute.
+ */
+void SampleReplay::setSecondsEvent(timeEvent timeDecoded)
+{
+    _timeDecoded = timeDecoded;
+}
+
+/**
+ * @brief Use RobustDcf::process() and dispatchEvents() instead of update().  The handlers subscribed to the decoder are called
+ * then, the epochEvent of the run functions and the seconds event are no longer called.
+ */
+void SampleReplay::setEventDriven(const bool enable)
+{
+    _eventDriven = enable;
+}
+
+/**
+ * @brief Feed a block of samples to the decoder.  Can be called multiple times to replay a stream in chunks.
+ * @param samples pin levels, one byte per ms, 0 = LOW, any other value = HIGH
+ * @param count number of samples
+ * @param epochDecoded optional callback, called each time the decoder has a new time stamp
+ */
+void SampleReplay::run(const uint8_t *samples, const uint32_t count, epochEvent epochDecoded)
+{
+    run(&samples, count, epochDecoded);
+}
+
+/**
+ * @brief Same as above, with a stream of samples for each receiver
+ */
+void SampleReplay::run(const uint8_t *const *samples, const uint32_t count, epochEvent epochDecoded)
+{
+    for (uint32_t i = 0; i < count; i++)
+    {
+        for (uint8_t j = 0; j < _receiverCount; j++)
+        {
+            currentSamples[j] = samples[j][i] ? HIGH : LOW;
+        }
+        HostShim::advanceMillis(1);
+        HAL_SYSTICK_Callback();
+        _sampleCount++;
+        checkEpoch(epochDecoded);
+    }
+}
+
+/**
+ * @brief Feed bit-packed samples to the decoder, in blocks of WORDS_PER_BLOCK words.
+ * @param packedBits pin levels, one bit per ms, the oldest sample is the LSb of the first word
+ * @param count number of samples
+ * @param epochDecoded optional callback, called each time the decoder has a new time stamp
+ */
+void SampleReplay::runPacked(const uint32_t *packedBits, const uint32_t count, epochEvent epochDecoded)
+{
+    runPacked(&packedBits, count, epochDecoded);
+}
+
+/**
+ * @brief Same as above, with a stream of samples for each receiver
+ */
+void SampleReplay::runPacked(const uint32_t *const *packedStreams, const uint32_t count, epochEvent epochDecoded)
+{
+    const uint32_t *blocks[PhaseDetector::MAX_RECEIVERS];
+    for (uint32_t pos = 0; pos < count; pos += WORDS_PER_BLOCK * 32)
+    {
+        const uint32_t blockSize = min(count - pos, WORDS_PER_BLOCK * 32);
+        for (uint8_t j = 0; j < _receiverCount; j++)
+        {
+            blocks[j] = packedStreams[j] + (pos >> 5);
+        }
+        HostShim::advanceMillis(blockSize);
+        _rd.process_samples(blocks, blockSize);
+        _sampleCount += blockSize;
+        checkEpoch(epochDecoded);
+    }
+}
+
+/**
+ * @brief Feed time stamped edges to the decoder, as the ISR would, and bin them every EDGE_POLL_INTERVAL, as the main loop would.
+ * Only the first receiver is used.
+ * @param edges edges, sorted by time stamp.  The time stamps are in µs and may wrap around.  The first edge sets the initial level.
+ * @param edgeCount number of edges
+ * @param duration length of the signal in ms, counted from the time stamp of the first edge
+ * @param epochDecoded optional callback, called each time the decoder has a new time stamp
+ */
+void SampleReplay::runEdges(const EDGE *edges, const uint32_t edgeCount, const uint32_t duration, epochEvent epochDecoded)
+{
+    if (!edgeCount)
+    {
+        return;
+    }
+    const uint32_t startTime = edges[0].timestamp;
+    uint32_t next = 0;
+    for (uint32_t pos = 0; pos < duration; pos += EDGE_POLL_INTERVAL)
+    {
+        const uint32_t blockSize = min(duration - pos, EDGE_POLL_INTERVAL);
+        const uint32_t now = startTime + (pos + blockSize) * 1000;
+        while (next < edgeCount && (int32_t)(edges[next].timestamp - now) < 0)
+        {
+            if (!_rd.process_edge(edges[next].timestamp, edges[next].level))
+            {
+                //Queue full : bin what has been queued so far, as a busy main loop would have done.
+                _rd.process_edges(edges[next].timestamp);
+                continue;
+            }
+            next++;
+        }
+        HostShim::advanceMillis(blockSize);
+        _rd.process_edges(now);
+        _sampleCount += blockSize;
+        checkEpoch(epochDecoded);
+    }
+}
+
+//Run the deferred stage of the decoder until all pending bins have been processed
+void SampleReplay::checkEpoch(epochEvent epochDecoded)
+{
+    if (_eventDriven)
+    {
+        if (_rd.process())
+        {
+            _epochCount += _rd.dispatchEvents();
+        }
+        return;
+    }
+    if (_timeDecoded)
+    {
+        RobustDcf::UTC_TIME time;
+        while (_rd.update(time))
+        {
+            _epochCount++;
+            _timeDecoded(_sampleCount, time);
+        }
+        return;
+    }
+    Chronos::EpochTime unixEpoch;
+    while (_rd.update(unixEpoch))
+    {
+        _epochCount++;
+        if (epochDecoded)
+        {
+            epochDecoded(_sampleCount, unixEpoch);
+        }
+    }
+}
+
+uint32_t SampleReplay::getSampleCount()
+{
+    return _sampleCount;
+}
+
+uint32_t SampleReplay::getEpochCount()
+{
+    return _epochCount;
+}
@@ -0,0 +1,57 @@
+/*
+ * This file is part of RobustDcf.
+ * 
+ * RobustDcf is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Foobar is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Foobar.  If not, see <https://www.gnu.org/licenses/>.
+ * 
+ * Copyright Christoph Tack, 2018
+*/
+/* Replays a recorded stream of 1ms pin samples through the complete RobustDcf decoder on a native build.
+ * Each sample advances the virtual clock of the host shim by 1ms and is handed to the decoder through the same SysTick callback
+ * that is used on the target.  There's no waiting, so the replay runs as fast as the host can decode.
+ * Alternatively, bit-packed samples can be fed in blocks, like a DMA buffer would on the target.
+ * Or the signal can be fed as a list of time stamped edges, like a pin change or input capture interrupt would.
+ * For antenna diversity, there's a stream of samples for each receiver.  Receiver i is connected to pin INPUT_PIN + i.
+ */
+#pragma once
+#include "robustDcf.h"
+
+class SampleReplay
+{
+public:
+	typedef void (*epochEvent)(const uint32_t sampleIndex, const Chronos::EpochTime unixEpoch);
+	typedef void (*timeEvent)(const uint32_t sampleIndex, const RobustDcf::UTC_TIME &time);
+	static const uint8_t INPUT_PIN = 0;
+	SampleReplay(RobustDcf &rd, const uint8_t receiverCount = 1);
+	void init();
+	void setSecondsEvent(timeEvent timeDecoded);
+	void setEventDriven(const bool enable);
+	void run(const uint8_t *samples, const uint32_t count, epochEvent epochDecoded);
+	void run(const uint8_t *const *samples, const uint32_t count, epochEvent epochDecoded);
+	void runPacked(const uint32_t *packedBits, const uint32_t count, epochEvent epochDecoded);
+	void runPacked(const uint32_t *const *packedStreams, const uint32_t count, epochEvent epochDecoded);
+	void runEdges(const EDGE *edges, const uint32_t edgeCount, const uint32_t duration, epochEvent epochDecoded);
+	uint32_t getSampleCount();
+	uint32_t getEpochCount();
+
+private:
+	static constexpr uint32_t WORDS_PER_BLOCK = 10; //320 samples : 32 bins, well within the pending bins of the phase detector
+	static constexpr uint32_t EDGE_POLL_INTERVAL = 10; //ms between calls of process_edges(), the length of a bin
+	void checkEpoch(epochEvent epochDecoded);
+	RobustDcf &_rd;
+	uint8_t _receiverCount;
+	uint32_t _sampleCount = 0;
+	uint32_t _epochCount = 0;
+	timeEvent _timeDecoded = nullptr;
+	bool _eventDriven = false;
+};
@@ -0,0 +1,159 @@
+/*
+ * This file is part of RobustDcf.
+ * 
+ * RobustDcf is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Foobar is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Foobar.  If not, see <https://www.gnu.org/licenses/>.
+ * 
+ * Copyright Christoph Tack, 2018
+*/
+#include "signalGenerator.h"
+
+const SignalGenerator::CHANNEL SignalGenerator::CLEAN = {INFINITY, 0, 0, 0, 0, 0, 0, 0};
+
+SignalGenerator::SignalGenerator(const CHANNEL &channel, uint32_t seed) : _channel(channel), _rng(seed), _noise(0, 1), _uniform(0, 1)
+{
+    //SNR = amplitude² / noise power, with the amplitude of the signal at the comparator normalized to 1
+    _noiseLevel = powf(10, -_channel.snr / 20);
+}
+
+/**
+ * @brief Start a new stream.
+ * @param unixEpoch UTC time of the first sample
+ * @param milliseconds ms into that second, so that streams don't all start on a second boundary
+ */
+void SignalGenerator::start(Chronos::EpochTime unixEpoch, uint16_t milliseconds)
+{
+    _startEpoch = _second = unixEpoch;
+    _startMillis = _millis = milliseconds;
+    _fade = 0;
+    _impulse = 0;
+    _minute = unixEpoch - unixEpoch % 60;
+    _frame = encodeMinute(_minute + 60);
+    _nextStart = edgeJitter();
+    nextSecond();
+}
+
+/**
+ * @brief Render the next samples of the stream.  Can be called repeatedly to render a stream in chunks.
+ * @param samples output levels of the receiver, one byte per ms : 1 while a pulse is received (active high), 0 otherwise
+ */
+void SignalGenerator::render(uint8_t *samples, uint32_t count)
+{
+    for (uint32_t i = 0; i < count; i++)
+    {
+        if (_millis == 1000)
+        {
+            _second++;
+            _millis = 0;
+            nextSecond();
+        }
+        //The pulse of the next second may start early, due to the jitter
+        const int16_t ms = _millis;
+        const bool pulse = (ms >= _start && ms < _end) || (_nextStart < 0 && ms - 1000 >= _nextStart && (_second + 1) % 60 != 59);
+        if (!_fade && _channel.fadeInterval && _uniform(_rng) * _channel.fadeInterval < 1)
+        {
+            _fade = _channel.fadeLength;
+        }
+        const bool fading = _fade > 0;
+        _fade -= fading;
+        //Signal amplitude +1 during the pulse, -1 otherwise, 0 while the carrier is lost.  The comparator slices at 0.
+        const float signal = fading ? 0 : (pulse ? 1 : -1);
+        bool level = signal + _noiseLevel * _noise(_rng) > 0;
+        if (!_impulse && _channel.impulseRate > 0 && _uniform(_rng) < _channel.impulseRate / 1000)
+        {
+            _impulse = _channel.impulseLength;
+        }
+        if (_impulse)
+        {
+            _impulse--;
+            level = true;
+        }
+        if (_channel.flipRate > 0 && _uniform(_rng) < _channel.flipRate)
+        {
+            level = !level;
+        }
+        samples[i] = level;
+        _millis++;
+    }
+}
+
+/**
+ * @brief UTC time of a sample, counted from start()
+ */
+Chronos::EpochTime SignalGenerator::getTime(uint32_t sampleIndex)
+{
+    return _startEpoch + (_startMillis + sampleIndex) / 1000;
+}
+
+/**
+ * @brief The 59 bits transmitted during the minute before the given time, just like DCF77 does it : each minute carries the German time
+ * at its end.  The A1 bit is set in the hour before a change between CET and CEST.
+ * @param unixEpoch UTC time at the start of the next minute
+ */
+uint64_t SignalGenerator::encodeMinute(Chronos::EpochTime unixEpoch)
+{
+    const int16_t utcOffset = RobustDcf::germanUtcOffset(unixEpoch);
+    const Chronos::EpochTime localTime = unixEpoch + utcOffset;
+    const int32_t days = localTime / 86400;
+    const uint32_t secondOfDay = localTime % 86400;
+    const Chronos::EpochTime transmitted = unixEpoch - 60;
+    FrameDecoder::FRAME frame;
+    EpochCalculator::civilFromDays(days, frame.year, frame.month, frame.day);
+    frame.weekday = (days + 3) % 7 + 1; //1970-01-01 was a thursday
+    frame.hour = secondOfDay / 3600;
+    frame.minute = secondOfDay / 60 % 60;
+    frame.isSummerTime = utcOffset == 7200;
+    frame.isWinterTime = !frame.isSummerTime;
+    frame.timeZoneChangeAnnounced = RobustDcf::germanUtcOffset(transmitted) != RobustDcf::germanUtcOffset(transmitted + 3600);
+    return FrameDecoder::encode(frame);
+}
+
+/**
+ * @brief Probability that noise inverts a sample at the given SNR : Q(amplitude / noise level)
+ */
+float SignalGenerator::sampleErrorRate(float snr)
+{
+    return 0.5f * erfcf(powf(10, snr / 20) / sqrtf(2));
+}
+
+/**
+ * @brief Prepare the pulse of the second that has just started
+ */
+void SignalGenerator::nextSecond()
+{
+    if (_second - _minute >= 60)
+    {
+        _minute = _second - _second % 60;
+        _frame = encodeMinute(_minute + 60);
+    }
+    _start = _nextStart;
+    _nextStart = edgeJitter();
+    _end = _second % 60 == 59 ? _start : _start + pulseLength(_second % 60);
+}
+
+/**
+ * @brief Random shift of an edge, in ms
+ */
+int16_t SignalGenerator::edgeJitter()
+{
+    return _channel.jitter ? (int16_t)(_rng() % (2 * _channel.jitter + 1)) - _channel.jitter : 0;
+}
+
+/**
+ * @brief Length of the pulse of a second in the minute, including the distortion and the jitter of its falling edge
+ */
+uint16_t SignalGenerator::pulseLength(uint8_t second)
+{
+    const int16_t length = ((_frame >> second) & 1 ? LONG_PULSE : SHORT_PULSE) + _channel.pulseDistortion + edgeJitter();
+    return length > 0 ? length : 0;
+}
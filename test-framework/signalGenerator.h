@@ -0,0 +1,75 @@
+/*
+ * This file is part of RobustDcf.
+ * 
+ * RobustDcf is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Foobar is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Foobar.  If not, see <https://www.gnu.org/licenses/>.
+ * 
+ * Copyright Christoph Tack, 2018
+*/
+/* Synthetic DCF77 signal : encodes UTC time into the minute frames that Mainflingen transmits and renders them as 1ms samples of a
+ * receiver output, as seen through a configurable channel.  This is the inverse of the FrameDecoder and the TimeZoneDecoder : the
+ * German time with its CET/CEST bits, the announcement bit in the hour before a change of the time zone, the date, the weekday
+ * and the parities.
+ * The channel models the impairments of a real receiver : white gaussian noise before the comparator (set by the SNR), random
+ * sample flips, jitter on the edges, pulses that are stretched or shortened by the AGC, fades during which the carrier is lost and
+ * impulse noise.  All randomness comes from a seeded generator, so a stream can be reproduced exactly.
+ */
+#pragma once
+#include <math.h>
+#include <random>
+#include "robustDcf.h"
+
+class SignalGenerator
+{
+public:
+	typedef struct
+	{
+		float snr;				 //!<dB, signal to noise ratio at the comparator of the receiver.  INFINITY for a noise free signal
+		float flipRate;			 //!<probability that a sample is inverted, on top of the noise
+		uint16_t jitter;		 //!<ms, each edge moves randomly by up to this much
+		int16_t pulseDistortion; //!<ms added to the length of each pulse, negative to shorten them
+		uint32_t fadeInterval;	 //!<ms, mean time between the starts of fades, which come at random.  0 for no fades.
+		uint32_t fadeLength;	 //!<ms, during a fade the carrier is lost and the receiver only outputs noise
+		float impulseRate;		 //!<impulses per second, e.g. from switching power supplies
+		uint16_t impulseLength;	 //!<ms that the output is stuck active during each impulse
+	} CHANNEL;
+	static const CHANNEL CLEAN; //!<no impairments at all
+	SignalGenerator(const CHANNEL &channel, uint32_t seed);
+	void start(Chronos::EpochTime unixEpoch, uint16_t milliseconds);
+	void render(uint8_t *samples, uint32_t count);
+	Chronos::EpochTime getTime(uint32_t sampleIndex);
+	static uint64_t encodeMinute(Chronos::EpochTime unixEpoch);
+	static float sampleErrorRate(float snr);
+
+private:
+	static const uint16_t SHORT_PULSE = 100; //!<ms, a 0-bit
+	static const uint16_t LONG_PULSE = 200;	 //!<ms, a 1-bit
+	void nextSecond();
+	int16_t edgeJitter();
+	uint16_t pulseLength(uint8_t second);
+	CHANNEL _channel;
+	std::mt19937 _rng;
+	std::normal_distribution<float> _noise;
+	std::uniform_real_distribution<float> _uniform;
+	float _noiseLevel;					//!<standard deviation of the noise, relative to the signal amplitude
+	Chronos::EpochTime _second = 0;		//!<UTC time of the current second
+	uint16_t _millis = 0;				//!<ms in the current second
+	Chronos::EpochTime _minute = 0;		//!<UTC time at the start of the minute that _frame is transmitted in
+	uint64_t _frame = 0;
+	int16_t _start = 0, _end = 0;		//!<ms in the current second where the pulse starts and ends
+	int16_t _nextStart = 0;				//!<ms from the start of the next second to its pulse, can be negative
+	uint32_t _fade = 0;					//!<ms left of the current fade
+	uint16_t _impulse = 0;				//!<ms left of the current impulse
+	Chronos::EpochTime _startEpoch = 0; //!<time of the first sample after start()
+	uint16_t _startMillis = 0;
+};